@@ -4,11 +4,22 @@
 #include "GL3DEngine.hpp"
 #include "RubikSolverPocket/RubikSolver.h"
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <glm/gtx/string_cast.hpp>
 
 #define CAMERA_LIMIT_MIN -2.8f
 #define CAMERA_LIMIT_MAX  1.f
+#define ANYTIME_MAX_DEPTH 5
+#define RESOLVE_REFERENCE_LENGTH 85 //Typical beginners solution, used before any full solve
+#define HEADLESS_FRAME_RATE 60.f
+#define PROFILE_CSV_FILE "profile.csv"
 
 namespace app {
 	double mouseX = 0, mouseY = 0;
@@ -84,8 +95,12 @@ namespace app {
 		enum AnimationStatus { Paused, Running };
 		enum MovementStatus { Solving, Shuffling, Fixing, Customizing, Idle };
 		std::vector<eng::Cube3D> body;
-		tool::Texture TEXTURE_STORAGE[6][3][3], TEX_HIDDEN;
+		tool::Texture TEXTURE_STORAGE[6][3][3], TEX_HIDDEN;//Only layers of TEXTURE_LAYERS
+		tool::TextureArray TEXTURE_LAYERS;
 		tool::Shader cubeShader;
+		tool::UniformBuffer frameBuffer;
+		tool::FrameUniforms frame;
+		eng::CubieMesh cubieMesh;
 		algo::Rubik solver;
 		ArcBallCamera camera;
 		std::vector<std::pair<eng::CentroidGroup, float>> solutionMovements;
@@ -94,9 +109,33 @@ namespace app {
 		AnimationStatus currentStatus;
 		MovementStatus actionStatus;
 		float animationSpeed = 5.f, rotationCount = 0.f;
-		std::vector<char> solution, mix;
-		bool mayusEnabled = false;
+		std::vector<char> solution;
+		algo::MoveSequence mix;
+		bool mayusEnabled = false, anytimeEnabled = true, colourNeutral = false, mergingEnabled = true;
 		std::shared_ptr<bool> globalProposalControl;
+		tool::FrameProfiler* profiler = nullptr;
+
+		//Anytime solver: improves the tail of solution while it is animated
+		algo::Rubik solveStart;
+		std::thread improver;
+		std::mutex planMutex;
+		std::atomic<bool> improverStop{ false };
+		std::atomic<std::size_t> playedMovements{ 0 };
+		std::size_t planVersion = 0, spliceVersion = 0, spliceBoundary = 0, spliceChars = 0;
+		std::vector<char> spliceMoves;
+		bool splicePending = false;
+
+		//Incremental re-solve: cachedSolution solves solveStart, movesSinceSolve reach the current state
+		std::vector<char> cachedSolution, movesSinceSolve;
+		std::size_t lastFullSolveLength = RESOLVE_REFERENCE_LENGTH;
+		bool cacheValid = true;
+		algo::SolutionCache solutionCache;
+
+		//Streaming solver: phases are appended to the plan while it is animated
+		std::thread streamer;
+		std::vector<std::pair<std::string, std::vector<char>>> streamedPhases;
+		std::atomic<bool> streamDone{ true };
+		bool streaming = false;
 
 		glm::vec3 currentCenterVector, currentAxisRot;
 		glm::mat4 projection = glm::mat4(1.0f);
@@ -117,10 +156,32 @@ namespace app {
 		}
 
 		void findRubikSolution() {
+			tool::ScopedTimer timer(profiler, tool::CpuSolver);
 			if (!solver.isSolved() && solutionMovements.empty()) {
+				stopImprover();
+				solveStart = solver;
 				solution.clear();
-				solver.solve(solution);
-				tool::fixSequenceLogic(solution);
+				if (reuseCachedSolution(solution)) {
+					solver.movSolver(solution);
+					std::cout << ">> Cached solution reused.\n";
+				}
+				else if (solutionCache.lookup(solver, solution, 'B', colourNeutral)) {
+					solver.movSolver(solution);
+					tool::fixSequenceLogic(solution);
+					lastFullSolveLength = solution.size();
+					std::cout << ">> Solution found in cache (" << solutionCache.hits << " hits).\n";
+				}
+				else if (colourNeutral) {
+					solver.solveColourNeutral(solution);
+					solutionCache.insert(solveStart, solution, 'B', true);
+					tool::fixSequenceLogic(solution);
+					lastFullSolveLength = solution.size();
+				}
+				else {
+					startStreaming();
+					actionStatus = Solving;
+					return;
+				}
 				solutionMovements = eng::parseSolverOutput(solution);
 				std::cout << ">> Expected: ";
 				for (auto& l : solution) {
@@ -128,18 +189,154 @@ namespace app {
 				}std::cout << std::endl;
 				solver.printAll();
 				actionStatus = Solving;
+				commitSolution();
 			}
 		}
 
+		//The whole plan is known: keep it for re-solves and improve it
+		void commitSolution() {
+			cachedSolution = movesSinceSolve = solution;
+			cacheValid = true;
+			if (anytimeEnabled)
+				startImprover();
+		}
+
+		void startStreaming() {
+			algo::Rubik state(solveStart);
+			streaming = true;
+			streamDone = false;
+			streamer = std::thread([this, state]() mutable {
+				state.solve([this](const char* phase, const std::vector<char>& moves) {
+					std::lock_guard<std::mutex> lock(planMutex);
+					streamedPhases.emplace_back(phase, moves);
+				});
+				streamDone = true;
+			});
+		}
+
+		//Only called between two movements
+		void appendStreamedPhases() {
+			if (!streaming)
+				return;
+			bool done = streamDone; //Read before taking the phases, nothing comes after it
+			std::vector<std::pair<std::string, std::vector<char>>> phases;
+			{
+				std::lock_guard<std::mutex> lock(planMutex);
+				phases.swap(streamedPhases);
+			}
+			for (auto& phase : phases) {
+				tool::fixSequenceLogic(phase.second);
+				solver.movSolver(phase.second);
+				solution.insert(solution.end(), phase.second.begin(), phase.second.end());
+				eng::appendSolverOutput(phase.second, solutionMovements);
+				std::cout << "\n>> " << phase.first << ": ";
+				for (auto& l : phase.second) {
+					std::cout << l;
+				}std::cout << std::endl;
+			}
+			if (done) {
+				streamer.join();
+				streaming = false;
+				solutionCache.insert(solveStart, solution);
+				lastFullSolveLength = solution.size();
+				solver.printAll();
+				commitSolution();
+			}
+		}
+
+		//Undo the moves made since the cached solve, then play its solution
+		bool reuseCachedSolution(std::vector<char>& candidate) {
+			if (!cacheValid)
+				return false;
+			candidate.assign(movesSinceSolve.rbegin(), movesSinceSolve.rend());
+			for (auto& mov : candidate)
+				mov = std::isupper(mov) ? std::tolower(mov) : std::toupper(mov);
+			candidate.insert(candidate.end(), cachedSolution.begin(), cachedSolution.end());
+			algo::Rubik::simplify(candidate);
+			if (candidate.size() > lastFullSolveLength) { //Clearly worse than solving again
+				candidate.clear();
+				return false;
+			}
+			algo::Rubik check(solver);
+			check.movSolver(candidate);
+			if (!check.isSolved()) {
+				candidate.clear();
+				return false;
+			}
+			return true;
+		}
+
+		void startImprover() {
+			++planVersion;
+			playedMovements = currentSMIndx;//Streamed phases may be animating already, 0 for a fresh plan
+			improverStop = false;
+			improver = std::thread(&RubikCube3D::improveRunningSolution, this);
+		}
+
+		void stopImprover() {
+			improverStop = true;
+			if (improver.joinable())
+				improver.join();
+			splicePending = false;
+		}
+
+		//Background thread: searches from a boundary ahead of the animation
+		void improveRunningSolution() {
+			for (int depth = 1; depth <= ANYTIME_MAX_DEPTH && !improverStop; ++depth) {
+				std::vector<char> plan;
+				std::vector<std::pair<eng::CentroidGroup, float>> parsedPlan;
+				std::size_t version;
+				{
+					std::lock_guard<std::mutex> lock(planMutex);
+					plan = solution;
+					parsedPlan = solutionMovements;
+					version = planVersion;
+				}
+				//Deeper searches take longer, leave room for the moves animated meanwhile
+				std::size_t boundary = playedMovements + 1 + depth * depth / 2;
+				if (boundary >= parsedPlan.size())
+					break;
+				std::size_t playedChars = 0;
+				for (std::size_t i = 0; i < boundary; ++i)
+					playedChars += std::size_t(abs(parsedPlan[i].second) / 90.f);
+				std::vector<char> played(plan.begin(), plan.begin() + playedChars);
+				std::vector<char> continuation(plan.begin() + playedChars, plan.end());
+				algo::Rubik state(solveStart);
+				state.movSolver(played);
+				algo::Rubik::simplify(continuation);
+				if (state.improveSolution(continuation, depth, improverStop)) {
+					std::lock_guard<std::mutex> lock(planMutex);
+					spliceVersion = version;
+					spliceBoundary = boundary;
+					spliceChars = playedChars;
+					spliceMoves = continuation;
+					splicePending = true;
+				}
+			}
+		}
+
+		//Only called between two movements
+		void spliceImprovedSolution() {
+			std::lock_guard<std::mutex> lock(planMutex);
+			if (splicePending && spliceVersion == planVersion && currentSMIndx <= spliceBoundary) {
+				solution.resize(spliceChars);
+				solution.insert(solution.end(), spliceMoves.begin(), spliceMoves.end());
+				solutionMovements.resize(spliceBoundary);
+				eng::appendSolverOutput(spliceMoves, solutionMovements);
+				++planVersion;
+				std::cout << "\n[ANYTIME]: Shorter solution found, " << solutionMovements.size() << " movements.\n";
+			}
+			splicePending = false;
+		}
+
 		void shuffleRubikRandom() {
 			if (solver.isSolved() && solutionMovements.empty()) {
 				mix.clear();
 				tool::randomShuffle(mix, rand() % 10 + 20);
 				solutionMovements = eng::parseSolverOutput(mix);
+				cacheValid = false;
 				std::cout << ">> Mixer movements: ";
-				for (auto& l : mix) {
-					cout << l;
-				}std::cout << std::endl;
+				std::cout << mix << std::endl;
 				solver.movSolver(mix);
 				solver.printAll();
 				actionStatus = Shuffling;
@@ -148,20 +345,25 @@ namespace app {
 
 		void customizeMoves(const char& mov_code) {
 			char fixed_mov = (mayusEnabled) ? std::toupper(mov_code) : mov_code;
-			std::vector<char> movs = {fixed_mov};
+			algo::MoveSequence movs;
+			movs.push_back(fixed_mov);
 			solutionMovements = eng::parseSolverOutput(movs);
 			solver.movSolver(movs);
+			movesSinceSolve.push_back(fixed_mov);
 			solver.printAll();
 			actionStatus = Customizing;
 		}
 
 		void execAnimations(float deltaTime) {
+			if (currentStatus == Paused && actionStatus == Solving) {
+				appendStreamedPhases();
+				spliceImprovedSolution();
+			}
 			if (!solutionMovements.empty()) {
 				if (currentSMIndx < solutionMovements.size() && currentStatus == Paused) {
 					std::size_t idx = 0;
-					eng::CenterMap::iterator it = eng::MAP_CENTERS.find(solutionMovements[currentSMIndx].first);
-					currentCenterVector = it->second;
-					currentAxisRot = glm::abs(it->second);
+					currentCenterVector = eng::axisVector(eng::describeLayer(solutionMovements[currentSMIndx].first));
+					currentAxisRot = glm::abs(currentCenterVector);
 					for (auto& cubie : body) {
 						if (idx < 9 && cubie.belongingTo(solutionMovements[currentSMIndx].first)) {
 							cubie.setAnimatedEnable(true, solutionMovements[currentSMIndx].second);
@@ -184,14 +386,15 @@ namespace app {
 						selectedCubie->rotateAround(deltaAngle, currentCenterVector, currentAxisRot);
 					if (rotationCount >= abs(solutionMovements[currentSMIndx].second)) {
 						currentStatus = Paused;
-						++currentSMIndx;
+						playedMovements = ++currentSMIndx;
 						for (auto& selectedCubie : currentGroup) {
 							selectedCubie->updateMembership(currentAxisRot);
 							selectedCubie->setAnimatedEnable(false, 0.f);
 						}
 					}
 				}
-				else {
+				else if (!streaming) {
+					stopImprover();
 					std::vector<std::pair<char, int>> wrongCentersSet;
 					if (fixerHeuristicRequired(wrongCentersSet) && actionStatus == Solving) {
 						std::cout << "\n[WARNING]: Some centers are not orientated correctly -> PROCEED TO FIX...\n";
@@ -202,8 +405,9 @@ namespace app {
 						std::cout << "\n-------------\n";
 						solutionMovements.clear();
 						/*Comentar las 2 lineas siguientes si no quieres que se ejecute visualmente el fixer*/
-						solution = tool::generateFixerSequence(wrongCentersSet);
-						solutionMovements = eng::parseSolverOutput(solution);
+						algo::MoveSequence fixer = tool::generateFixerSequence(wrongCentersSet);
+						solution.assign(fixer.begin(), fixer.end());
+						solutionMovements = eng::parseSolverOutput(fixer);
 						currentStatus = Paused;
 						currentSMIndx = 0;
 						actionStatus = Fixing;
@@ -220,13 +424,30 @@ namespace app {
 		}
 
 	public:
+		~RubikCube3D() {
+			if (streamer.joinable())
+				streamer.join();
+			stopImprover();
+		}
+
 		void init() {
-			cubeShader.loadFromMemory(tool::defaultVertexShaderCode, tool::defaultFragmentShaderCode);
+			cubeShader.loadFromMemory(tool::instancedVertexShaderCode, tool::instancedFragmentShaderCode);
+			cubeShader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+			frameBuffer.init(sizeof(tool::FrameUniforms), FRAME_UNIFORMS_BINDING);
+			cubieMesh.init();
 			globalProposalControl = std::make_shared<bool>(false);
 			mouseX = mouseY = 0.f;
 			currentStatus = Paused;
 			actionStatus = Idle;
 			std::array<bool, 6> centersFixFlags;
+			std::vector<std::string> layerFiles;
+			std::map<std::string, int32_t> layerOfFile;//Repeated images share a layer
+			auto addLayer = [&](tool::Texture& texture, const std::string& path) {
+				auto inserted = layerOfFile.emplace(path, int32_t(layerFiles.size()));
+				if (inserted.second)
+					layerFiles.push_back(path);
+				texture.setLayer(inserted.first->second);
+			};
 			std::ifstream settingsFile("res/faces.conf");
 			if (settingsFile.is_open()) {
 				std::string path;
@@ -236,7 +457,7 @@ namespace app {
 					for (std::size_t i = 0; i < 3; ++i) {
 						for (std::size_t j = 0; j < 3; ++j) {
 							std::getline(settingsFile, path);
-							TEXTURE_STORAGE[idx][i][j].loadImageFromFile(path.c_str());
+							addLayer(TEXTURE_STORAGE[idx][i][j], path);
 						}
 					}
 					if(idx != 5)
@@ -248,7 +469,8 @@ namespace app {
 				std::cerr << "[ERROR]: File of settings does not exist.\n";
 				exit(EXIT_FAILURE);
 			}
-			TEX_HIDDEN.loadImageFromFile("res/hidden.jpg");
+			addLayer(TEX_HIDDEN, "res/hidden.jpg");
+			TEXTURE_LAYERS.loadImagesFromFiles(layerFiles);
 
 			std::size_t cIdx = 0;
 			for (float x = -1.f; x < 2.f; x += 1.f) {
@@ -319,6 +541,43 @@ namespace app {
 				mayusEnabled = false;
 				std::cout << "[SPAM]: Lowercase movements enabled.\n";
 			}
+			if (glfwGetKey(window, GLFW_KEY_KP_3) == GLFW_PRESS) {
+				anytimeEnabled = true;
+				std::cout << "[SPAM]: Anytime solver enabled.\n";
+			}
+			else if (glfwGetKey(window, GLFW_KEY_KP_0) == GLFW_PRESS) {
+				anytimeEnabled = false;
+				std::cout << "[SPAM]: Anytime solver disabled.\n";
+			}
+			if (glfwGetKey(window, GLFW_KEY_KP_MULTIPLY) == GLFW_PRESS) {
+				colourNeutral = true;
+				std::cout << "[SPAM]: Colour neutral solver enabled.\n";
+			}
+			else if (glfwGetKey(window, GLFW_KEY_KP_DIVIDE) == GLFW_PRESS) {
+				colourNeutral = false;
+				std::cout << "[SPAM]: Colour neutral solver disabled.\n";
+			}
+			if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+				mergingEnabled = true;
+				std::cout << "[SPAM]: Draw merging enabled.\n";
+			}
+			else if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+				mergingEnabled = false;
+				std::cout << "[SPAM]: Draw merging disabled, one draw per cubie.\n";
+			}
+			if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+				tool::RenderState& state = tool::renderState();
+				std::cout << "[SPAM]: " << state.issuedCalls() << " binds issued, " << state.filteredCalls() << " redundant binds filtered.\n";
+				state.resetCounters();
+			}
+			if (profiler != nullptr) {
+				if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+					profiler->printStatistics();
+				if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+					profiler->startCsv(PROFILE_CSV_FILE);
+				else if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS)
+					profiler->stopCsv();
+			}
 			if (actionStatus == Idle) {
 				if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
 					findRubikSolution();
@@ -357,23 +616,61 @@ namespace app {
 				cameraZoom = CAMERA_LIMIT_MIN;
 			else if (cameraZoom > CAMERA_LIMIT_MAX)
 				cameraZoom = CAMERA_LIMIT_MAX;
-			if (actionStatus != Idle)
+			update(deltaTime);
+		}
+
+		//Animations of the cube and the camera, the part of a frame that needs no input
+		void update(const float& deltaTime) {
+			if (actionStatus != Idle) {
+				tool::ScopedTimer timer(profiler, tool::CpuAnimations);
 				execAnimations(deltaTime);
+			}
 			if (actionStatus == Solving || actionStatus == Fixing)
-				camera.animateCamera(glfwGetTime() * 0.45);
+				camera.animateCamera(eng::getTime() * 0.45);
+		}
+
+		//Times the animations and the solver, nullptr to stop
+		void setProfiler(tool::FrameProfiler* frameProfiler) {
+			profiler = frameProfiler;
 		}
 
-		void draw(float deltaTime) {
-			cubeShader.setMat4("view", camera.getView());
+		bool isIdle() const {
+			return actionStatus == Idle;
+		}
+
+		//Action of a key without a window: S solve, M shuffle, f b l r u d turns; ignored unless idle
+		void runAction(const char& action) {
+			if (actionStatus != Idle)
+				return;
+			if (action == 'S')
+				findRubikSolution();
+			else if (action == 'M')
+				shuffleRubikRandom();
+			else if (std::string("fblrud").find(action) != std::string::npos)
+				customizeMoves(action);
+			else
+				std::cerr << "[WARNING]: Unknown action " << action << ".\n";
+		}
+
+		//Records the cubies in commands, submitted by the caller with the rest of the frame
+		void draw(float deltaTime, eng::CommandList& commands) {
+			//One upload of the per-frame uniforms, read by every shader of the frame
+			frame.view = camera.getView();
 			projection = glm::ortho(-5.f - cameraZoom, 5.f + cameraZoom, -5.f - cameraZoom, 5.f + cameraZoom, -1000.f, 1000.f);
-			cubeShader.setMat4("projection", projection);
-			float variant = glm::cos(glfwGetTime()) * 0.3 + 0.65;
-			cubeShader.setVec3("lightColor", variant, variant, variant);
-			//cubeShader.setVec3("lightColor", -1, -1, -1);
-			cubeShader.setVec3("lightPos", camera.getGlobalPosition());
-			cubeShader.setVec3("viewPos", camera.getGlobalPosition());
+			frame.projection = projection;
+			double time = eng::getTime();
+			float variant = glm::cos(time) * 0.3 + 0.65;
+			frame.lightColor = glm::vec3(variant, variant, variant);
+			//frame.lightColor = glm::vec3(-1, -1, -1);
+			frame.lightPos = frame.viewPos = camera.getGlobalPosition();
+			frame.time = float(time);
+			frameBuffer.update(&frame, sizeof(frame));
+			commands.setMerging(mergingEnabled);
+			eng::DrawState state = cubieMesh.drawState(cubeShader.ID, TEXTURE_LAYERS.getID());
+			eng::CubieInstance instance;
 			for (auto& cubie : body) {
-				cubie.draw(cubeShader);
+				cubie.writeInstance(instance);
+				commands.record(state, instance);
 			}
 		}
 
@@ -402,6 +699,8 @@ namespace app {
 		RubikCube3D cubeMaster;
 		eng::SkyBox3D background;
 		tool::Texture skyboxTexture;
+		eng::CommandList commands;
+		tool::FrameProfiler profiler;
 		int32_t screenPosX, screenPosY, lastScreenPosX, lastScreenPosY;
 	public:
 		GL3D_WindowApplication(const uint32_t& w, const uint32_t& h, char* title);
@@ -417,6 +716,8 @@ namespace app {
 		//																	"res/orange.jpg" ,"res/yellow.jpg" ,"res/white.jpg" });
 		//background.init(skyboxTexture);
 		cubeMaster.init();
+		cubeMaster.setProfiler(&profiler);
+		commands.setProfiler(&profiler);
 		glfwGetWindowPos(screen, &lastScreenPosX, &lastScreenPosY);
 		system("cls");
 	}
@@ -426,27 +727,102 @@ namespace app {
 		float deltaTime = 0.f;
 		glfwSetWindowOpacity(screen, 1.f);
 		while (!glfwWindowShouldClose(screen)) {
+			profiler.beginFrame();
 			glClearColor(0.1f, 0.15f, 0.4f, 1.0f);
 
+			profiler.beginGpu(tool::GpuClear);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			profiler.endGpu();
 			float currentFrame = glfwGetTime();
 			deltaTime = currentFrame - lastFrame;
 			lastFrame = currentFrame;
 			glfwGetWindowPos(screen, &screenPosX, &screenPosY);
 			if (screenPosX == lastScreenPosX && screenPosY == lastScreenPosY) {
+				tool::ScopedTimer timer(&profiler, tool::CpuController);
 				cubeMaster.onUserController(screen, deltaTime);
 			}
 			else {
 				lastScreenPosX = screenPosX;
 				lastScreenPosY = screenPosY;
 			}
-			//background.draw(cubeMaster.getViewMatrix(), cubeMaster.getProjectionMatrix());
-			cubeMaster.draw(deltaTime);
+			//background.record(commands);
+			cubeMaster.draw(deltaTime, commands);
+			commands.submit();
 			glfwSwapBuffers(screen);
 			glfwPollEvents();
+			profiler.endFrame();
 		}
+		profiler.release();
 		glfwTerminate();
 	}
+
+#ifdef RUBIK_HEADLESS
+	//The scene of GL3D_WindowApplication without a window or a display server: frames at a fixed rate into
+	//an offscreen framebuffer, actions given up front instead of keys
+	class GL3D_HeadlessApplication {
+	private:
+		eng::HeadlessContext context;//Declared first, destroyed after the GL objects of cubeMaster
+		RubikCube3D cubeMaster;
+		eng::CommandList commands;
+		tool::FrameProfiler profiler;
+		bool ready;
+	public:
+		GL3D_HeadlessApplication(const uint32_t& w, const uint32_t& h);
+		//Runs actions (see RubikCube3D::runAction) one after another, each when the cube is idle, until the last one
+		//ends or maxFrames frames; frame n is saved as <framePrefix>n.ppm unless framePrefix is empty, and its
+		//times as a row of profileCsv unless it is empty
+		int start(const std::string& actions, const std::size_t& maxFrames, const float& frameRate, const std::string& framePrefix,
+		          const std::string& profileCsv = "");
+	};
+
+	GL3D_HeadlessApplication::GL3D_HeadlessApplication(const uint32_t& w, const uint32_t& h) {
+		srand(time(0));
+		ready = context.init(w, h);
+		if (ready) {
+			eng::headlessTime = 0.;
+			cubeMaster.init();
+			cubeMaster.setProfiler(&profiler);
+			commands.setProfiler(&profiler);
+		}
+	}
+
+	int GL3D_HeadlessApplication::start(const std::string& actions, const std::size_t& maxFrames, const float& frameRate, const std::string& framePrefix,
+	                                    const std::string& profileCsv) {
+		if (!ready || (!profileCsv.empty() && !profiler.startCsv(profileCsv)))
+			return EXIT_FAILURE;
+		const float deltaTime = 1.f / frameRate;
+		std::size_t nextAction = 0, frame = 0;
+		auto begin = std::chrono::steady_clock::now();
+		for (; frame < maxFrames; ++frame) {
+			if (cubeMaster.isIdle() && nextAction == actions.size())
+				break;
+			profiler.beginFrame();//Before the action: the solver adds its time to this frame
+			if (cubeMaster.isIdle())
+				cubeMaster.runAction(actions[nextAction++]);
+			eng::headlessTime += deltaTime;
+			glClearColor(0.1f, 0.15f, 0.4f, 1.0f);
+			profiler.beginGpu(tool::GpuClear);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			profiler.endGpu();
+			cubeMaster.update(deltaTime);
+			cubeMaster.draw(deltaTime, commands);
+			commands.submit();
+			if (!framePrefix.empty()) {
+				std::ostringstream fileName;
+				fileName << framePrefix << std::setw(5) << std::setfill('0') << frame << ".ppm";
+				if (!context.saveFrame(fileName.str()))
+					return EXIT_FAILURE;
+			}
+			profiler.endFrame();
+		}
+		glFinish();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		std::cout << "[SPAM]: " << frame << " frames, " << seconds * 1e3 / std::max<std::size_t>(frame, 1) << " ms per frame.\n";
+		profiler.release();
+		profiler.printStatistics();
+		return EXIT_SUCCESS;
+	}
+#endif
 }
 
 #endif//APPLICATION_HPP_
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include "RubikSolverPocket/RubikSolver.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define BENCHMARK_SCRAMBLE_LENGTH 30
+
+namespace app {
+	//Every heap allocation of the program while a benchmark counts them (src/BenchmarkAllocations.cpp)
+	extern std::atomic<bool> countingAllocations;
+	extern std::atomic<unsigned long> heapAllocations;
+
+	//Headless timing of the solver on random scrambles, single thread
+	class SolverBenchmark {
+	public:
+		//Prints time, length, arena and heap allocations per solve, the first solve warms the arena up
+		static void run(const std::size_t& solves, const char& method = 'B', const unsigned int& seed = 0) {
+			static const char moves[] = "RrLlFfBbUuDd";
+			std::mt19937 rng(seed);
+			std::vector<char> mix(BENCHMARK_SCRAMBLE_LENGTH), solution;
+			std::vector<algo::Rubik> cubes(solves + 1);
+			for (auto& cube : cubes) {
+				for (auto& mov : mix)
+					mov = moves[rng() % 12];
+				cube.movSolver(mix);
+			}
+			cubes[0].solve(solution, method);
+
+			std::size_t length = 0;
+			unsigned long allocations = algo::Rubik::arenaAllocations();
+			heapAllocations = 0;
+			countingAllocations = true;
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 1; i < cubes.size(); ++i) {
+				cubes[i].solve(solution, method);
+				length += solution.size();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			countingAllocations = false;
+			allocations = algo::Rubik::arenaAllocations() - allocations;
+
+			std::size_t n = std::max<std::size_t>(solves, 1);
+			std::cout << "[SPAM]: " << solves << " solves (" << method << "), "
+				<< seconds * 1e6 / n << " us and " << double(length) / n << " moves per solve, "
+				<< double(allocations) / n << " arena and " << double(heapAllocations) / n << " heap allocations per solve.\n";
+		}
+	};
+}
+
+#endif
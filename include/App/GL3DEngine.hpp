@@ -3,6 +3,10 @@
 
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
+#ifdef RUBIK_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
@@ -10,33 +14,71 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <memory>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "Tools.hpp"
+#include "Profiler.hpp"
 
 namespace eng {
   enum CentroidGroup { Front, Back, Left, Right, Up, Down, None };
   //                     0     1     2      3    4    5     6
 
-  const std::unordered_map<char, CentroidGroup> CENTERS = { {'f', CentroidGroup::Left},//Orange
-                                                            {'b', CentroidGroup::Right},//Red
-                                                            {'r', CentroidGroup::Back},//Blue
-                                                            {'l', CentroidGroup::Front},//Green
-                                                            {'u', CentroidGroup::Down},//Yellow
-                                                            {'d', CentroidGroup::Up} };//White
-  typedef std::unordered_map<CentroidGroup, glm::vec3> CenterMap;
-
-  CenterMap MAP_CENTERS = { {CentroidGroup::Front, glm::vec3( 0.f,  0.f,  1.f)},
-                            {CentroidGroup::Back,  glm::vec3( 0.f,  0.f, -1.f)},
-                            {CentroidGroup::Left,  glm::vec3(-1.f,  0.f,  0.f)},
-                            {CentroidGroup::Right, glm::vec3( 1.f,  0.f,  0.f)},
-                            {CentroidGroup::Up,    glm::vec3( 0.f,  1.f,  0.f)},
-                            {CentroidGroup::Down,  glm::vec3( 0.f, -1.f,  0.f)} };
+  //Movement of the solver notation: center of the solver (order of rubik::Rubik::center), layer of the engine,
+  //axis vector of that layer and angle of the quarter turn (sign included)
+  struct MoveDescriptor {
+    char notation;
+    int face;
+    CentroidGroup group;
+    int axis[3];
+    float angle;
+  };
+
+  //Indexed by rubik::MoveSequence::code()
+  constexpr MoveDescriptor MOVE_TABLE[12] = { {'R', 2, CentroidGroup::Back,  { 0,  0, -1},  90.f},//Blue
+                                              {'r', 2, CentroidGroup::Back,  { 0,  0, -1}, -90.f},
+                                              {'L', 4, CentroidGroup::Front, { 0,  0,  1}, -90.f},//Green
+                                              {'l', 4, CentroidGroup::Front, { 0,  0,  1},  90.f},
+                                              {'F', 1, CentroidGroup::Left,  {-1,  0,  0},  90.f},//Orange
+                                              {'f', 1, CentroidGroup::Left,  {-1,  0,  0}, -90.f},
+                                              {'B', 3, CentroidGroup::Right, { 1,  0,  0}, -90.f},//Red
+                                              {'b', 3, CentroidGroup::Right, { 1,  0,  0},  90.f},
+                                              {'U', 0, CentroidGroup::Down,  { 0, -1,  0},  90.f},//Yellow
+                                              {'u', 0, CentroidGroup::Down,  { 0, -1,  0}, -90.f},
+                                              {'D', 5, CentroidGroup::Up,    { 0,  1,  0}, -90.f},//White
+                                              {'d', 5, CentroidGroup::Up,    { 0,  1,  0},  90.f} };
+
+  constexpr bool notationAgrees() {
+    for (int c = 0; c < 12; ++c)
+      if (MOVE_TABLE[c].notation != rubik::MoveSequence::notation(c))
+        return false;
+    return true;
+  }
+  static_assert(notationAgrees(), "MOVE_TABLE must follow the codes of rubik::MoveSequence");
+
+  //Precondition: movement is one of RrLlFfBbUuDd
+  constexpr const MoveDescriptor& describeMove(const char& movement) {
+    return MOVE_TABLE[rubik::MoveSequence::code(movement)];
+  }
+
+  //Clockwise movement of a layer
+  constexpr const MoveDescriptor& describeLayer(const CentroidGroup& group) {
+    int c = 0;
+    while (c < 10 && MOVE_TABLE[c].group != group)
+      c += 2;
+    return MOVE_TABLE[c];
+  }
+
+  inline glm::vec3 axisVector(const MoveDescriptor& descriptor) {
+    return glm::vec3(descriptor.axis[0], descriptor.axis[1], descriptor.axis[2]);
+  }
+
 	void initOpenGL() {
     srand(time(0));
 		glfwInit();
@@ -69,29 +111,343 @@ namespace eng {
 		return window;
 	}
 
-  std::vector<std::pair<CentroidGroup, float>> parseSolverOutput(std::vector<char>& solution) {
-    std::vector<std::pair<CentroidGroup, float>> parsedSolution;
-    char lastMovementCode = 'a';
-    for (const char& movement : solution) {
-      std::pair<CentroidGroup, float> parsedMovement = {CENTERS.find(std::tolower(movement))->second, ((std::isupper(movement)) ? -90.f : 90.f)};
-      CenterMap::iterator centerO_ = MAP_CENTERS.find(parsedMovement.first);
-      parsedMovement.second *= (centerO_->second[0] + centerO_->second[1] + centerO_->second[2]);
-      if (!parsedSolution.empty() && movement == lastMovementCode)
+  //Seconds of the frame clock: glfwGetTime() with a window, advanced by the frame loop of a headless run
+  double headlessTime = -1.;
+
+  inline double getTime() {
+    return (headlessTime < 0.) ? glfwGetTime() : headlessTime;
+  }
+
+#ifdef RUBIK_HEADLESS
+  //OpenGL 3.3 core context without a window or a display server: EGL surfaceless (Mesa) or else a pbuffer
+  //of the default display. Frames are drawn into a framebuffer object, multisampled like the window
+  class HeadlessContext {
+  private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    GLuint FBO = 0, resolveFBO = 0, renderbuffers[3] = { 0, 0, 0 };
+    GLsizei width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+
+    bool openDisplay(bool& surfaceless) {
+      const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+      surfaceless = extensions != nullptr && std::strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr;
+      if (surfaceless) {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != nullptr)
+          display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+          return true;
+        surfaceless = false;
+      }
+      display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+      return display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr);
+    }
+
+  public:
+    ~HeadlessContext() {
+      if (context != EGL_NO_CONTEXT) {
+        if (FBO != 0) {
+          glDeleteFramebuffers(1, &FBO);
+          glDeleteFramebuffers(1, &resolveFBO);
+          glDeleteRenderbuffers(3, renderbuffers);
+        }
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+      }
+      if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+      if (display != EGL_NO_DISPLAY)
+        eglTerminate(display);
+    }
+
+    //samples: 0 draws straight into a single sampled framebuffer
+    bool init(const uint32_t& w, const uint32_t& h, GLsizei samples = 16) {
+      bool surfaceless;
+      if (!openDisplay(surfaceless) || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "[ERROR]: No EGL display for OpenGL.\n";
+        return false;
+      }
+      const EGLint configAttributes[] = { EGL_SURFACE_TYPE, (surfaceless) ? 0 : EGL_PBUFFER_BIT,
+                                          EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+      const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                           EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+      const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+      EGLConfig config;
+      EGLint configs = 0;
+      if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0 ||
+          (context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes)) == EGL_NO_CONTEXT) {
+        std::cerr << "[ERROR]: No OpenGL 3.3 core context.\n";
+        return false;
+      }
+      if (!surfaceless)
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+      if (!eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "[ERROR]: Failed to make the headless context current.\n";
+        return false;
+      }
+      if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        std::cerr << "[ERROR]: Failed to initialize GLAD.\n";
+        return false;
+      }
+
+      width = GLsizei(w);
+      height = GLsizei(h);
+      GLint maxSamples = 0;
+      glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+      samples = std::min<GLsizei>(samples, maxSamples);
+      glGenFramebuffers(1, &FBO);
+      glGenRenderbuffers(3, renderbuffers);
+      glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+      glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+      glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+      glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+      glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+      bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+      if (samples > 0) {//Resolved into a single sampled color buffer before reading
+        glGenFramebuffers(1, &resolveFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[2]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[2]);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+      }
+      if (!complete) {
+        std::cerr << "[ERROR]: Incomplete headless framebuffer.\n";
+        return false;
+      }
+      glViewport(0, 0, width, height);
+      glEnable(GL_DEPTH_TEST);
+      glEnable(GL_MULTISAMPLE);
+      glDepthFunc(GL_LESS);
+      return true;
+    }
+
+    //Binary PPM of the last frame, top row first
+    bool saveFrame(const std::string& fileName) {
+      if (resolveFBO != 0) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFBO);
+      }
+      pixels.resize(std::size_t(width) * height * 3);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+      glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+      std::ofstream file(fileName, std::ios::binary);
+      if (!file.is_open()) {
+        std::cerr << "[ERROR]: Can not write " << fileName << ".\n";
+        return false;
+      }
+      file << "P6\n" << width << " " << height << "\n255\n";
+      for (GLsizei row = height - 1; row >= 0; --row)//OpenGL rows start at the bottom
+        file.write((const char*)&pixels[std::size_t(row) * width * 3], std::size_t(width) * 3);
+      return bool(file);
+    }
+  };
+#endif
+
+  //Appends the movements of any sequence of chars (std::vector<char>, rubik::MoveSequence) to parsedSolution
+  template <class Sequence>
+  void appendSolverOutput(const Sequence& solution, std::vector<std::pair<CentroidGroup, float>>& parsedSolution) {
+    char lastMovementCode = 'a';//Never merged with the movements already parsed
+    for (const char movement : solution) {
+      const MoveDescriptor& descriptor = describeMove(movement);
+      std::pair<CentroidGroup, float> parsedMovement = {descriptor.group, descriptor.angle};
+      if (!parsedSolution.empty() && movement == lastMovementCode) {
         parsedSolution.back().second *= 2.f;
-      else
+        lastMovementCode = 'a';//A third one is a new movement, not 360 degrees
+      }
+      else {
         parsedSolution.emplace_back(parsedMovement);
-      lastMovementCode = movement;
+        lastMovementCode = movement;
+      }
     }
+  }
+
+  template <class Sequence>
+  std::vector<std::pair<CentroidGroup, float>> parseSolverOutput(const Sequence& solution) {
+    std::vector<std::pair<CentroidGroup, float>> parsedSolution;
+    appendSolverOutput(solution, parsedSolution);
     return parsedSolution;
   }
 
+  //Packed vertex of the cubie mesh, 12 bytes instead of 8 floats
+  struct CubieVertex {
+    GLshort position[3];//Normalized: a cube of half size 1, scaled to 0.5 by the cube shaders
+    GLubyte uv[2];//Normalized
+    GLuint normal;//GL_INT_2_10_10_10_REV, normalized
+  };
+  static_assert(sizeof(CubieVertex) == 12, "CubieVertex must be packed");
+
+  constexpr GLuint packNormal(const int& x, const int& y, const int& z) {
+    return GLuint(x * 511 & 0x3FF) | (GLuint(y * 511 & 0x3FF) << 10) | (GLuint(z * 511 & 0x3FF) << 20);
+  }
+
+  //Every component is -1, 0 or 1
+  constexpr CubieVertex cubieVertex(const int& x, const int& y, const int& z, const int& u, const int& v,
+                                    const int& nx, const int& ny, const int& nz) {
+    return { { GLshort(x * 32767), GLshort(y * 32767), GLshort(z * 32767) }, { GLubyte(u * 255), GLubyte(v * 255) }, packNormal(nx, ny, nz) };
+  }
+
+  //Unit cube, 4 vertices per face: position, uv and normal; faces BACK, FRONT, LEFT, RIGHT, DOWN, UP
+  constexpr CubieVertex CUBIE_VERTICES[24] = {
+    //BACK
+    cubieVertex(-1, -1, -1,  0, 0,   0,  0, -1),
+    cubieVertex( 1, -1, -1,  1, 0,   0,  0, -1),
+    cubieVertex( 1,  1, -1,  1, 1,   0,  0, -1),
+    cubieVertex(-1,  1, -1,  0, 1,   0,  0, -1),
+    //FRONT
+    cubieVertex(-1, -1,  1,  0, 0,   0,  0,  1),
+    cubieVertex( 1, -1,  1,  1, 0,   0,  0,  1),
+    cubieVertex( 1,  1,  1,  1, 1,   0,  0,  1),
+    cubieVertex(-1,  1,  1,  0, 1,   0,  0,  1),
+    //LEFT
+    cubieVertex(-1,  1,  1,  0, 0,  -1,  0,  0),
+    cubieVertex(-1,  1, -1,  1, 0,  -1,  0,  0),
+    cubieVertex(-1, -1, -1,  1, 1,  -1,  0,  0),
+    cubieVertex(-1, -1,  1,  0, 1,  -1,  0,  0),
+    //RIGHT
+    cubieVertex( 1,  1,  1,  0, 0,   1,  0,  0),
+    cubieVertex( 1,  1, -1,  1, 0,   1,  0,  0),
+    cubieVertex( 1, -1, -1,  1, 1,   1,  0,  0),
+    cubieVertex( 1, -1,  1,  0, 1,   1,  0,  0),
+    //DOWN
+    cubieVertex(-1, -1, -1,  0, 0,   0, -1,  0),
+    cubieVertex( 1, -1, -1,  1, 0,   0, -1,  0),
+    cubieVertex( 1, -1,  1,  1, 1,   0, -1,  0),
+    cubieVertex(-1, -1,  1,  0, 1,   0, -1,  0),
+    //UP
+    cubieVertex(-1,  1, -1,  0, 0,   0,  1,  0),
+    cubieVertex( 1,  1, -1,  1, 0,   0,  1,  0),
+    cubieVertex( 1,  1,  1,  1, 1,   0,  1,  0),
+    cubieVertex(-1,  1,  1,  0, 1,   0,  1,  0)
+  };
+
+  //Two triangles per face, the 6 indices of a face start at 6 * face
+  constexpr GLushort CUBIE_INDICES[36] = {  0,  1,  2,  2,  3,  0,
+                                            4,  5,  6,  6,  7,  4,
+                                            8,  9, 10, 10, 11,  8,
+                                           12, 13, 14, 14, 15, 12,
+                                           16, 17, 18, 18, 19, 16,
+                                           20, 21, 22, 22, 23, 20 };
+
+  //Attributes of a cubie in the instanced draw, layers of a tool::TextureArray in the face order of CUBIE_VERTICES
+  struct CubieInstance {
+    glm::mat4 model;
+    glm::mat4 animation;
+    glm::mat3 normalMatrix;
+    GLint faceLayers[6];
+  };
+
+  //Inverse transpose of the upper 3x3 of model, computed when a cubie moves instead of once per vertex
+  inline glm::mat3 normalMatrixOf(const glm::mat4& model) {
+    return glm::transpose(glm::inverse(glm::mat3(model)));
+  }
+
+  class CubieMesh;
+
+  //Passes of a frame, in drawing order; the background is drawn without depth test
+  enum RenderPass { Background, Opaque };
+
+  //Everything a draw binds and issues, commands of equal DrawState are merged into one call
+  struct DrawState {
+    RenderPass pass;
+    GLuint program;
+    GLenum textureTarget;
+    GLuint texture;
+    GLuint vertexArray;
+    GLenum mode;
+    GLsizei count;//Vertices, or indices if indexType is not 0
+    GLenum indexType;
+    CubieMesh* instanceSource;//Mesh that streams the CubieInstance of the commands, nullptr if they have none
+
+    //Pass, then from the most expensive change to the cheapest: program, texture, mesh
+    uint64_t sortKey() const {
+      return (uint64_t(pass) << 60) | (uint64_t(program & 0xFFFFF) << 40) | (uint64_t(texture & 0xFFFFF) << 20) | uint64_t(vertexArray & 0xFFFFF);
+    }
+
+    bool operator == (const DrawState& state) const {
+      return pass == state.pass && program == state.program && textureTarget == state.textureTarget && texture == state.texture &&
+             vertexArray == state.vertexArray && mode == state.mode && count == state.count && indexType == state.indexType &&
+             instanceSource == state.instanceSource;
+    }
+  };
+
+  //The only copy of CUBIE_VERTICES and CUBIE_INDICES in the GPU: one VBO, one EBO and one VAO, shared by every cubie.
+  //The VAO also reads one CubieInstance per instance from a stream buffer
+  class CubieMesh {
+  private:
+    typedef uint32_t GL_Object3D;
+    GL_Object3D VBO = 0, EBO = 0, instanceVBO = 0, VAO = 0;
+  public:
+    ~CubieMesh() {
+      if (VAO == 0)
+        return;
+      glDeleteVertexArrays(1, &VAO);
+      glDeleteBuffers(1, &VBO);
+      glDeleteBuffers(1, &EBO);
+      glDeleteBuffers(1, &instanceVBO);
+      tool::renderState().forget();
+    }
+
+    void init() {
+      glGenVertexArrays(1, &VAO);
+      glGenBuffers(1, &VBO);
+      glGenBuffers(1, &EBO);
+      glGenBuffers(1, &instanceVBO);
+      tool::renderState().bindVertexArray(VAO);
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(CUBIE_VERTICES), CUBIE_VERTICES, GL_STATIC_DRAW);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBIE_INDICES), CUBIE_INDICES, GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CubieVertex), (void*)offsetof(CubieVertex, position));
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(1, 2, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CubieVertex), (void*)offsetof(CubieVertex, uv));
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CubieVertex), (void*)offsetof(CubieVertex, normal));
+      glEnableVertexAttribArray(2);
+      glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+      for (GLuint column = 0; column < 8; ++column) {//model: 3-6, animation: 7-10
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(CubieInstance), (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+      }
+      for (GLuint column = 0; column < 3; ++column) {//normalMatrix: 13-15
+        glVertexAttribPointer(13 + column, 3, GL_FLOAT, GL_FALSE, sizeof(CubieInstance), (void*)(offsetof(CubieInstance, normalMatrix) + column * sizeof(glm::vec3)));
+        glEnableVertexAttribArray(13 + column);
+        glVertexAttribDivisor(13 + column, 1);
+      }
+      for (GLuint half = 0; half < 2; ++half) {
+        glVertexAttribIPointer(11 + half, 3, GL_INT, sizeof(CubieInstance), (void*)(offsetof(CubieInstance, faceLayers) + 3 * half * sizeof(GLint)));
+        glEnableVertexAttribArray(11 + half);
+        glVertexAttribDivisor(11 + half, 1);
+      }
+      tool::renderState().bindVertexArray(0);
+    }
+
+    //Draw of cubies with a shader of tool::instancedVertexShaderCode and the texture array of their layers
+    DrawState drawState(const GLuint& program, const GLuint& textureArray) {
+      return { Opaque, program, GL_TEXTURE_2D_ARRAY, textureArray, VAO, GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, this };
+    }
+
+    void uploadInstances(const CubieInstance* instances, const std::size_t& count) {
+      glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+      glBufferData(GL_ARRAY_BUFFER, count * sizeof(CubieInstance), instances, GL_STREAM_DRAW);
+    }
+  };
+
+  //Transform and face layers of a cubie, drawn as a CubieInstance of the CubieMesh
 	class Cube3D {
 	private:
-    typedef uint32_t GL_Object3D;
-    GL_Object3D VBO;
-    GL_Object3D VAO;
 		tool::Texture* TEX_F, *TEX_B, *TEX_L, *TEX_R, *TEX_U, *TEX_D;
     glm::mat4 model, animModel, mOrbit, proposal;
+    glm::mat3 normalMatrix, animNormalMatrix;
     std::array<CentroidGroup, 3> clusters;
     glm::vec3 currentMembership;
     float rotAngle = 0.f, goalAngle = 0.f;
@@ -99,69 +455,20 @@ namespace eng {
     bool animated = false, fixOrientationRequired = false;
     std::shared_ptr<bool> proposalEnabled;
 
-    GLfloat VBD[288] = {
-      //BACK
-         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,  0.0f,  0.0f, -1.0f,
-          0.5f, -0.5f, -0.5f,  1.0f, 0.0f,  0.0f,  0.0f, -1.0f,
-          0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  0.0f,  0.0f, -1.0f,
-          0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  0.0f,  0.0f, -1.0f,
-         -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,  0.0f,  0.0f, -1.0f,
-         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,  0.0f,  0.0f, -1.0f,
-      //FRONT
-         -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  0.0f,  0.0f,  1.0f,
-          0.5f, -0.5f,  0.5f,  1.0f, 0.0f,  0.0f,  0.0f,  1.0f,
-          0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,  0.0f,  1.0f,
-          0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,  0.0f,  1.0f,
-         -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,  0.0f,  0.0f,  1.0f,
-         -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  0.0f,  0.0f,  1.0f,
-      //LEFT
-         -0.5f,  0.5f,  0.5f,  0.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-         -0.5f,  0.5f, -0.5f,  1.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-         -0.5f, -0.5f, -0.5f,  1.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-         -0.5f, -0.5f, -0.5f,  1.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-         -0.5f, -0.5f,  0.5f,  0.0f, 1.0f, -1.0f,  0.0f,  0.0f,
-         -0.5f,  0.5f,  0.5f,  0.0f, 0.0f, -1.0f,  0.0f,  0.0f,
-      //RIGHT
-          0.5f,  0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f,  0.0f,
-          0.5f,  0.5f, -0.5f,  1.0f, 0.0f,  1.0f,  0.0f,  0.0f,
-          0.5f, -0.5f, -0.5f,  1.0f, 1.0f,  1.0f,  0.0f,  0.0f,
-          0.5f, -0.5f, -0.5f,  1.0f, 1.0f,  1.0f,  0.0f,  0.0f,
-          0.5f, -0.5f,  0.5f,  0.0f, 1.0f,  1.0f,  0.0f,  0.0f,
-          0.5f,  0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f,  0.0f,
-      //DOWN
-         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,  0.0f, -1.0f,  0.0f,
-          0.5f, -0.5f, -0.5f,  1.0f, 0.0f,  0.0f, -1.0f,  0.0f,
-          0.5f, -0.5f,  0.5f,  1.0f, 1.0f,  0.0f, -1.0f,  0.0f,
-          0.5f, -0.5f,  0.5f,  1.0f, 1.0f,  0.0f, -1.0f,  0.0f,
-         -0.5f, -0.5f,  0.5f,  0.0f, 1.0f,  0.0f, -1.0f,  0.0f,
-         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,  0.0f, -1.0f,  0.0f,
-      //UP
-         -0.5f,  0.5f, -0.5f,  0.0f, 0.0f,  0.0f,  1.0f,  0.0f,
-          0.5f,  0.5f, -0.5f,  1.0f, 0.0f,  0.0f,  1.0f,  0.0f,
-          0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,  1.0f,  0.0f,
-          0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  0.0f,  1.0f,  0.0f,
-         -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,  0.0f,  1.0f,  0.0f,
-         -0.5f,  0.5f, -0.5f,  0.0f, 0.0f,  0.0f,  1.0f,  0.0f
-    };
-
-    void destroyDrawable(GL_Object3D& VBO, GL_Object3D& VAO);
-    void drawSingleFace(const std::size_t& begin, const std::size_t& count);
     void updateCenters(const glm::vec3& centers);
+    void updateProposal();
     
 	public:
 		Cube3D(tool::Texture& refT_R, tool::Texture& refT_L, tool::Texture& refT_U,
            tool::Texture& refT_D, tool::Texture& refT_F, tool::Texture& refT_B);
     Cube3D(){
       TEX_F = TEX_B = TEX_L = TEX_R = TEX_U = TEX_D = nullptr;
-      VBO = 0;
-      VAO = 0;
       clusters.fill(CentroidGroup::None);
       model = mOrbit = proposal = glm::mat4(1.0f);
+      normalMatrix = animNormalMatrix = glm::mat3(1.0f);
       currentOrientation = 0;
     }
 
-    ~Cube3D();
-
     void setFrontTex(tool::Texture& refT) {
       TEX_F = &refT;
     }
@@ -211,11 +518,12 @@ namespace eng {
       proposalEnabled = globalEnabled;
     }
 
-    void draw(tool::Shader& shader);
+    void writeInstance(CubieInstance& instance);
     void setFixRequired(bool enabled);
     void translate(const glm::vec3& position);
     void rotateAround(const float& angle, const glm::vec3& center, const glm::vec3& axis);
     std::string getPrintableModel();
+    const glm::mat4& getModel();
     bool belongingTo(const CentroidGroup& center);
     bool needFixOrientation();
     bool isCenter();
@@ -226,52 +534,23 @@ namespace eng {
 
   Cube3D::Cube3D(tool::Texture& refT_R, tool::Texture& refT_L, tool::Texture& refT_U,
                  tool::Texture& refT_D, tool::Texture& refT_F, tool::Texture& refT_B) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VBD), VBD, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
     TEX_F = &refT_F; TEX_B = &refT_B;
     TEX_L = &refT_L; TEX_R = &refT_R;
     TEX_U = &refT_U; TEX_D = &refT_D;
-    glBindVertexArray(0);
     model = mOrbit = proposal = glm::mat4(1.0f);
+    normalMatrix = animNormalMatrix = glm::mat3(1.0f);
     clusters.fill(CentroidGroup::None);
     currentOrientation = 0;
   }
 
-  Cube3D::~Cube3D() {
-    destroyDrawable(VBO, VAO);
-  }
-
-  void Cube3D::destroyDrawable(GL_Object3D& VBO, GL_Object3D& VAO) {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-  }
-
-  void Cube3D::drawSingleFace(const std::size_t& begin, const std::size_t& count) {
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, begin, count);
-  }
-
   float getTimedScale(float time) {
     time = time + time / float(rand() % 5 + 8);
     return std::min(glm::cos(time), 2.f) + 1.5f;
   }
 
-  void Cube3D::draw(tool::Shader& shader) {
-    if(animated)
-      shader.setMat4("model", animModel);
-    else
-      shader.setMat4("model", model);
+  void Cube3D::updateProposal() {
     if (proposalEnabled != nullptr && *proposalEnabled == true) {
-      float time = glfwGetTime();
+      float time = getTime();
       time = std::fmod(time, 5.5);
       proposal = glm::scale(glm::mat4(1.f), glm::vec3(getTimedScale(time),
                                                       getTimedScale(time), 
@@ -284,30 +563,22 @@ namespace eng {
     else {
       proposal = glm::mat4(1.f);
     }
-    shader.setMat4("animation", proposal);
-    TEX_B->apply();
-    shader.use();
-    drawSingleFace(0, 6);
-    TEX_F->apply();
-    shader.use();
-    drawSingleFace(6, 6);
-    TEX_L->apply();
-    shader.use();
-    drawSingleFace(12, 6);
-    TEX_R->apply();
-    shader.use();
-    drawSingleFace(18, 6);
-    TEX_D->apply();
-    shader.use();
-    drawSingleFace(24, 6);
-    TEX_U->apply();
-    shader.use();
-    drawSingleFace(30, 6);
+  }
+
+  void Cube3D::writeInstance(CubieInstance& instance) {
+    instance.model = (animated) ? animModel : model;
+    instance.normalMatrix = (animated) ? animNormalMatrix : normalMatrix;
+    updateProposal();
+    instance.animation = proposal;
+    const tool::Texture* faces[6] = { TEX_B, TEX_F, TEX_L, TEX_R, TEX_D, TEX_U };
+    for (int face = 0; face < 6; ++face)
+      instance.faceLayers[face] = faces[face]->getLayer();
   }
 
   void Cube3D::translate(const glm::vec3& position) {
     model = glm::translate(glm::mat4(1.f), position);
     animModel = model;
+    normalMatrix = animNormalMatrix = normalMatrixOf(model);
     currentMembership = position;
     updateCenters(position);
   }
@@ -316,6 +587,10 @@ namespace eng {
     return glm::to_string(model);
   }
 
+  const glm::mat4& Cube3D::getModel() {
+    return model;
+  }
+
   bool Cube3D::belongingTo(const CentroidGroup& center) {
     for(const CentroidGroup& axis : clusters)
       if (axis == center)
@@ -330,6 +605,7 @@ namespace eng {
     mOrbit = glm::rotate(mOrbit, glm::radians(rotAngle), axis);
     mOrbit = glm::translate(mOrbit, center);
     animModel = mOrbit * model;
+    animNormalMatrix = normalMatrixOf(animModel);
   }
 
   bool Cube3D::isCenter() {
@@ -352,6 +628,7 @@ namespace eng {
       }
     }
     model = animModel;
+    normalMatrix = animNormalMatrix;
     rotAngle = 0.f;
   }
 
@@ -378,6 +655,103 @@ namespace eng {
     goalAngle = goal;
   }
 
+  //Draws of a frame, recorded in any order. submit() sorts them by DrawState::sortKey() and merges runs of equal
+  //state into one instanced call, so binds and calls are bounded by the unique resources, not by the objects
+  class CommandList {
+  private:
+    struct DrawCommand {
+      DrawState state;
+      uint32_t order;//Of recording, ties keep it
+      int32_t instance;//Index in instances, -1 if the draw has none
+    };
+    std::vector<DrawCommand> commands;
+    std::vector<CubieInstance> instances, run;
+    bool merging = true;
+    std::size_t draws = 0;
+    tool::FrameProfiler* profiler = nullptr;
+
+    void issue(const DrawState& state) {
+      tool::RenderState& renderState = tool::renderState();
+      renderState.useProgram(state.program);
+      renderState.bindTexture(state.textureTarget, state.texture);
+      renderState.bindVertexArray(state.vertexArray);
+      if (state.instanceSource != nullptr) {
+        state.instanceSource->uploadInstances(run.data(), run.size());
+        if (state.indexType != 0)
+          glDrawElementsInstanced(state.mode, state.count, state.indexType, (void*)0, GLsizei(run.size()));
+        else
+          glDrawArraysInstanced(state.mode, 0, state.count, GLsizei(run.size()));
+      }
+      else if (state.indexType != 0)
+        glDrawElements(state.mode, state.count, state.indexType, (void*)0);
+      else
+        glDrawArrays(state.mode, 0, state.count);
+      ++draws;
+    }
+
+  public:
+    void record(const DrawState& state) {
+      commands.push_back({ state, uint32_t(commands.size()), -1 });
+    }
+
+    void record(const DrawState& state, const CubieInstance& instance) {
+      commands.push_back({ state, uint32_t(commands.size()), int32_t(instances.size()) });
+      instances.push_back(instance);
+    }
+
+    //Disabled: one call per command, to measure what merging saves
+    void setMerging(const bool& enabled) {
+      merging = enabled;
+    }
+
+    //Times every pass on the GPU, nullptr to stop
+    void setProfiler(tool::FrameProfiler* frameProfiler) {
+      profiler = frameProfiler;
+    }
+
+    //Of the last submit()
+    std::size_t drawCalls() const {
+      return draws;
+    }
+
+    void submit() {
+      std::sort(commands.begin(), commands.end(), [](const DrawCommand& a, const DrawCommand& b) {
+        uint64_t keyA = a.state.sortKey(), keyB = b.state.sortKey();
+        return (keyA != keyB) ? keyA < keyB : a.order < b.order;
+      });
+      draws = 0;
+      for (std::size_t begin = 0, end; begin < commands.size(); begin = end) {
+        const DrawState& state = commands[begin].state;
+        end = begin + 1;
+        if (merging && state.instanceSource != nullptr)
+          while (end < commands.size() && commands[end].state == state)
+            ++end;
+        if (begin == 0 || commands[begin - 1].state.pass != state.pass) {
+          if (profiler != nullptr) {
+            if (begin != 0)
+              profiler->endGpu();
+            profiler->beginGpu((state.pass == Background) ? tool::GpuSkybox : tool::GpuCube);
+          }
+          if (state.pass == Background)
+            glDisable(GL_DEPTH_TEST);
+          else
+            glEnable(GL_DEPTH_TEST);
+        }
+        run.clear();
+        if (state.instanceSource != nullptr)
+          for (std::size_t i = begin; i < end; ++i)
+            run.push_back(instances[commands[i].instance]);
+        issue(state);
+      }
+      if (profiler != nullptr && !commands.empty())
+        profiler->endGpu();
+      if (!commands.empty() && commands.back().state.pass == Background)
+        glEnable(GL_DEPTH_TEST);
+      commands.clear();
+      instances.clear();
+    }
+  };
+
   class SkyBox3D {
   private:
     typedef uint32_t GL_Object3D;
@@ -425,38 +799,35 @@ namespace eng {
       -1.0f, -1.0f,  1.0f,
        1.0f, -1.0f,  1.0f
     };
-    GL_Object3D VBO;
-    GL_Object3D VAO;
+    GL_Object3D VBO = 0;
+    GL_Object3D VAO = 0;
     tool::Shader skyboxShader;
     tool::Texture* SKYBOX_TEXTURE;
   public:
     ~SkyBox3D() {
+      if (VAO == 0)//Never initialized
+        return;
       glDeleteVertexArrays(1, &VAO);
       glDeleteBuffers(1, &VBO);
+      tool::renderState().forget();
     }
 
     void init(tool::Texture& texture) {
       glGenVertexArrays(1, &VAO);
       glGenBuffers(1, &VBO);
-      glBindVertexArray(VAO);
+      tool::renderState().bindVertexArray(VAO);
       glBindBuffer(GL_ARRAY_BUFFER, VBO);
       glBufferData(GL_ARRAY_BUFFER, sizeof(VBD), VBD, GL_STATIC_DRAW);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
       glEnableVertexAttribArray(0);
       skyboxShader.loadFromMemory(tool::defaultVertexSkyBoxShaderCode, tool::defaultFragmentSkyBoxShaderCode);
+      skyboxShader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
       SKYBOX_TEXTURE = &texture;
     }
 
-    void draw(const glm::mat4& view, const glm::mat4& projection) {
-      glDisable(GL_DEPTH_TEST);
-      skyboxShader.use();
-      skyboxShader.setMat4("view", view);
-      skyboxShader.setMat4("projection", projection);
-      glBindVertexArray(VAO);
-      SKYBOX_TEXTURE->skyboxModeApply();
-      glDrawArrays(GL_TRIANGLES, 0, 36);
-      //glBindVertexArray(0);
-      glEnable(GL_DEPTH_TEST);
+    //View and projection of the frame uniforms
+    void record(CommandList& commands) {
+      commands.record({ Background, skyboxShader.ID, GL_TEXTURE_CUBE_MAP, SKYBOX_TEXTURE->getID(), VAO, GL_TRIANGLES, 36, 0, nullptr });
     }
   };
 
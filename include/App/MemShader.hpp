@@ -4,58 +4,92 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "RenderState.hpp"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <utility>
+#include <vector>
+
+//Per-frame data of the cube and skybox shaders, std140 block "Frame" in tool::UniformBuffer
+#define FRAME_UNIFORMS_BINDING 0
+#define FRAME_UNIFORM_BLOCK "layout(std140) uniform Frame {\n" \
+                            "  mat4 view;\n" \
+                            "  mat4 projection;\n" \
+                            "  vec3 lightColor;\n" \
+                            "  float time;\n" \
+                            "  vec3 lightPos;\n" \
+                            "  vec3 viewPos;\n" \
+                            "};\n"
 
 namespace tool {
 
-  const char* defaultVertexShaderCode = "#version 330 core\n"
-                                        "layout(location = 0) in vec3 aPos;\n"
-                                        "layout(location = 1) in vec2 aTexCoord;\n"
-                                        "layout(location = 2) in vec3 aNormal;\n"
-                                        "out vec3 FragPos;\n"
-                                        "out vec3 Normal;\n"
-                                        "out vec2 TexCoord;\n"
-                                        "uniform mat4 model;\n"
-                                        "uniform mat4 view;\n"
-                                        "uniform mat4 animation;\n"
-                                        "uniform mat4 projection;\n"
-                                        "void main()\n"
-                                        "{\n"
-                                        "  FragPos = vec3(model * vec4(aPos, 1.0));\n"
-                                        "  Normal = mat3(transpose(inverse(model))) * aNormal;\n"
-                                        "  gl_Position = projection * view * animation * vec4(FragPos, 1.0f);\n"
-                                        "  TexCoord = vec2(aTexCoord.x, aTexCoord.y);\n"
-                                        "}";
-
-  const char* defaultFragmentShaderCode = "#version 330 core\n"
-                                          "out vec4 FragColor;\n"
-                                          "in vec2 TexCoord;\n"
-                                          "in vec3 Normal;\n"
-                                          "in vec3 FragPos;\n"
-                                          "uniform vec3 lightPos;\n"
-                                          "uniform vec3 viewPos;\n"
-                                          "uniform vec3 lightColor;\n"
-                                          "uniform sampler2D tex_face;\n"
+  //Same layout as FRAME_UNIFORM_BLOCK: vec3 aligned to 16 bytes, time fills the vec3 before it
+  struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 lightColor;
+    float time;
+    glm::vec3 lightPos;
+    float padding0;
+    glm::vec3 viewPos;
+    float padding1;
+  };
+  static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms must follow the std140 layout of FRAME_UNIFORM_BLOCK");
+
+  //Every cubie in one instanced draw: model, animation and the layers of its 6 faces are instance attributes,
+  //the face of a vertex is gl_VertexID / 4 (order of eng::CUBIE_VERTICES)
+  const char* instancedVertexShaderCode = "#version 330 core\n"
+                                          FRAME_UNIFORM_BLOCK
+                                          "layout(location = 0) in vec3 aPos;\n"
+                                          "layout(location = 1) in vec2 aTexCoord;\n"
+                                          "layout(location = 2) in vec3 aNormal;\n"
+                                          "layout(location = 3) in mat4 aModel;\n"
+                                          "layout(location = 7) in mat4 aAnimation;\n"
+                                          "layout(location = 11) in ivec3 aLayersBFL;\n"
+                                          "layout(location = 12) in ivec3 aLayersRDU;\n"
+                                          "layout(location = 13) in mat3 aNormalMatrix;\n"
+                                          "out vec3 FragPos;\n"
+                                          "out vec3 Normal;\n"
+                                          "out vec2 TexCoord;\n"
+                                          "flat out int Layer;\n"
                                           "void main()\n"
                                           "{\n"
-                                          "  float ambientStrength = 0.3;\n"
-                                          "  vec3 ambient = ambientStrength * vec3(1.0,1.0,1.0);\n"
-                                          "  vec3 norm = normalize(Normal);\n"
-                                          "  vec3 lightDir = normalize(lightPos - FragPos);\n"
-                                          "  float diff = max(dot(norm, lightDir), 0.0);\n"
-                                          "  vec3 diffuse = diff * lightColor * 0.52;\n"
-                                          "  float specularStrength = 0.3;\n"
-                                          "  vec3 viewDir = normalize(viewPos - FragPos);\n"
-                                          "  vec3 reflectDir = reflect(-lightDir, norm);\n"
-                                          "  float spec = pow(max(dot(viewDir, reflectDir), 0.0), 3);\n"
-                                          "  vec3 specular = specularStrength * spec * lightColor;\n"
-                                          "  vec3 result = ambient + diffuse + specular;\n"
-                                          "  FragColor = vec4(lightColor,0.0) - vec4(result, 1.0) * texture(tex_face, TexCoord);\n"
+                                          "  FragPos = vec3(aModel * vec4(0.5 * aPos, 1.0));\n"
+                                          "  Normal = aNormalMatrix * aNormal;\n"
+                                          "  gl_Position = projection * view * aAnimation * vec4(FragPos, 1.0f);\n"
+                                          "  TexCoord = vec2(aTexCoord.x, aTexCoord.y);\n"
+                                          "  int face = gl_VertexID / 4;\n"
+                                          "  Layer = (face < 3) ? aLayersBFL[face] : aLayersRDU[face - 3];\n"
                                           "}";
 
+  const char* instancedFragmentShaderCode = "#version 330 core\n"
+                                            FRAME_UNIFORM_BLOCK
+                                            "out vec4 FragColor;\n"
+                                            "in vec2 TexCoord;\n"
+                                            "in vec3 Normal;\n"
+                                            "in vec3 FragPos;\n"
+                                            "flat in int Layer;\n"
+                                            "uniform sampler2DArray tex_faces;\n"
+                                            "void main()\n"
+                                            "{\n"
+                                            "  float ambientStrength = 0.3;\n"
+                                            "  vec3 ambient = ambientStrength * vec3(1.0,1.0,1.0);\n"
+                                            "  vec3 norm = normalize(Normal);\n"
+                                            "  vec3 lightDir = normalize(lightPos - FragPos);\n"
+                                            "  float diff = max(dot(norm, lightDir), 0.0);\n"
+                                            "  vec3 diffuse = diff * lightColor * 0.52;\n"
+                                            "  float specularStrength = 0.3;\n"
+                                            "  vec3 viewDir = normalize(viewPos - FragPos);\n"
+                                            "  vec3 reflectDir = reflect(-lightDir, norm);\n"
+                                            "  float spec = pow(max(dot(viewDir, reflectDir), 0.0), 3);\n"
+                                            "  vec3 specular = specularStrength * spec * lightColor;\n"
+                                            "  vec3 result = ambient + diffuse + specular;\n"
+                                            "  FragColor = vec4(lightColor,0.0) - vec4(result, 1.0) * texture(tex_faces, vec3(TexCoord, Layer));\n"
+                                            "}";
+
   const char* defaultFragmentSkyBoxShaderCode = "#version 330 core\n"
                                                 "out vec4 FragColor;\n"
                                                 "in vec3 TexCoords;\n"
@@ -66,10 +100,9 @@ namespace tool {
                                                 "}";
 
   const char* defaultVertexSkyBoxShaderCode = "#version 330 core\n"
+                                              FRAME_UNIFORM_BLOCK
                                               "layout(location = 0) in vec3 aPos;\n"
                                               "out vec3 TexCoords;\n"
-                                              "uniform mat4 projection;\n"
-                                              "uniform mat4 view;\n"
                                               "void main()\n"
                                               "{\n"
                                               "  TexCoords = aPos;\n"
@@ -142,69 +175,129 @@ namespace tool {
       glDeleteShader(fragment);
       if (gShaderCode != nullptr)
         glDeleteShader(geometry);
+      cacheUniformLocations();
+    }
+
+    //Location of an active uniform, -1 if the program does not use it; resolved at link time, without GL calls
+    GLint getLocation(const std::string& name) const {
+      for (const auto& uniform : uniforms)
+        if (uniform.first == name)
+          return uniform.second;
+      return -1;
+    }
+
+    //Attaches the uniform block blockName, if the program has it, to the binding point of a UniformBuffer
+    void bindUniformBlock(const char* blockName, const GLuint& binding) {
+      GLuint index = glGetUniformBlockIndex(ID, blockName);
+      if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
     }
 
     void use() {
-      glUseProgram(ID);
+      renderState().useProgram(ID);
     }
 
+    //By location, for the frame loop
+    void setInt(const GLint& location, int value) const
+    {
+      glUniform1i(location, value);
+    }
+    void setFloat(const GLint& location, float value) const
+    {
+      glUniform1f(location, value);
+    }
+    void setVec3(const GLint& location, const glm::vec3& value) const
+    {
+      glUniform3fv(location, 1, &value[0]);
+    }
+    void setMat3(const GLint& location, const glm::mat3& mat) const
+    {
+      glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(const GLint& location, const glm::mat4& mat) const
+    {
+      glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const {
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+      glUniform1i(getLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+      glUniform1i(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-      glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+      glUniform1f(getLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-      glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+      glUniform2fv(getLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-      glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+      glUniform2f(getLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-      glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+      glUniform3fv(getLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-      glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+      glUniform3f(getLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-      glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+      glUniform4fv(getLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-      glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+      glUniform4f(getLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-      glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+      glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-      glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+      glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-      glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+      glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
   private:
+    std::vector<std::pair<std::string, GLint>> uniforms;
+
+    void cacheUniformLocations() {
+      uniforms.clear();
+      GLint count = 0;
+      glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+      for (GLint i = 0; i < count; ++i) {
+        GLchar name[256];
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ID, GLuint(i), sizeof(name), &length, &size, &type, name);
+        GLint location = glGetUniformLocation(ID, name);
+        if (location == -1)//Member of a uniform block
+          continue;
+        std::string uniformName(name, length);
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+          uniformName.resize(uniformName.size() - 3);
+        uniforms.emplace_back(uniformName, location);
+      }
+    }
+
     void checkCompileErrors(GLuint shader, std::string type)
     {
       GLint success;
@@ -229,6 +322,29 @@ namespace tool {
       }
     }
   };
+
+  //Buffer of a std140 uniform block, attached to a binding point shared by every program that binds the block
+  class UniformBuffer {
+  private:
+    GLuint ID = 0;
+  public:
+    ~UniformBuffer() {
+      if (ID != 0)
+        glDeleteBuffers(1, &ID);
+    }
+
+    void init(const GLsizeiptr& size, const GLuint& binding) {
+      glGenBuffers(1, &ID);
+      glBindBuffer(GL_UNIFORM_BUFFER, ID);
+      glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+      glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    void update(const void* data, const GLsizeiptr& size) {
+      glBindBuffer(GL_UNIFORM_BUFFER, ID);
+      glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    }
+  };
 }
 
 #endif//MEM_SHADER_HPP_
\ No newline at end of file
@@ -0,0 +1,196 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define PROFILER_WINDOW 600 //Frames of the rolling percentiles
+
+namespace tool {
+  //CPU sections are timed with ScopedTimer and may nest (the solver runs inside the controller),
+  //GPU sections with GL_TIME_ELAPSED queries, one at a time
+  enum ProfileSection { CpuFrame, CpuController, CpuAnimations, CpuSolver, GpuClear, GpuSkybox, GpuCube, PROFILE_SECTIONS };
+  const int FIRST_GPU_SECTION = GpuClear;
+  const char* const PROFILE_SECTION_NAMES[PROFILE_SECTIONS] = { "frame", "controller", "animations", "solver",
+                                                                "clear_gpu", "skybox_gpu", "cube_gpu" };
+
+  //Milliseconds of every section of every frame, rolling p50/p99 and an optional CSV with one row per frame.
+  //Queries are double-buffered: the results of a frame are read two frames later and only if the GPU already
+  //has them, so measuring never waits for the GPU
+  class FrameProfiler {
+  private:
+    typedef std::chrono::steady_clock Clock;
+    static const int GPU_SECTIONS = PROFILE_SECTIONS - FIRST_GPU_SECTION;
+    struct FrameSlot {
+      std::size_t frame = 0;
+      double milliseconds[PROFILE_SECTIONS];
+      GLuint queries[GPU_SECTIONS] = {};
+      bool issued[GPU_SECTIONS] = {};
+    };
+    FrameSlot slots[2];
+    std::size_t frame = 0;
+    Clock::time_point frameStart;
+    std::vector<double> history[PROFILE_SECTIONS];
+    std::size_t samples[PROFILE_SECTIONS] = {};
+    std::ofstream csv;
+
+    FrameSlot& slot() {
+      return slots[frame % 2];
+    }
+
+    void record(const int& section, const double& milliseconds) {
+      if (history[section].size() < PROFILER_WINDOW)
+        history[section].push_back(milliseconds);
+      else
+        history[section][samples[section] % PROFILER_WINDOW] = milliseconds;
+      ++samples[section];
+    }
+
+    //A GPU section without result (not drawn, or not finished yet) is -1: left empty in the CSV
+    void resolve(FrameSlot& done) {
+      for (int gpu = 0; gpu < GPU_SECTIONS; ++gpu) {
+        double& milliseconds = done.milliseconds[FIRST_GPU_SECTION + gpu];
+        milliseconds = -1.;
+        if (!done.issued[gpu])
+          continue;
+        GLint available = 0;
+        glGetQueryObjectiv(done.queries[gpu], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+          GLuint64 nanoseconds = 0;
+          glGetQueryObjectui64v(done.queries[gpu], GL_QUERY_RESULT, &nanoseconds);
+          milliseconds = nanoseconds * 1e-6;
+        }
+      }
+      for (int section = 0; section < PROFILE_SECTIONS; ++section)
+        if (done.milliseconds[section] >= 0.)
+          record(section, done.milliseconds[section]);
+      if (csv.is_open()) {
+        csv << done.frame;
+        for (int section = 0; section < PROFILE_SECTIONS; ++section) {
+          csv << ",";
+          if (done.milliseconds[section] >= 0.)
+            csv << done.milliseconds[section];
+        }
+        csv << "\n";
+      }
+    }
+
+    static double percentile(std::vector<double> values, const double& fraction) {
+      std::size_t rank = std::min(values.size() - 1, std::size_t(fraction * values.size()));
+      std::nth_element(values.begin(), values.begin() + rank, values.end());
+      return values[rank];
+    }
+
+  public:
+    //Waits for the last two frames, then frees the queries
+    //Precondition: the context of the queries is current, call it before destroying the context
+    void release() {
+      if (slots[0].queries[0] != 0) {
+        glFinish();
+        for (std::size_t pending = std::min<std::size_t>(frame, 2); pending > 0; --pending)
+          resolve(slots[(frame - pending) % 2]);
+      }
+      for (auto& done : slots) {
+        if (done.queries[0] != 0)
+          glDeleteQueries(GPU_SECTIONS, done.queries);
+        std::fill(done.queries, done.queries + GPU_SECTIONS, 0);
+      }
+      stopCsv();
+    }
+
+    //The frame clock starts before the old results are read, polling them may be where the driver waits
+    void beginFrame() {
+      frameStart = Clock::now();
+      FrameSlot& current = slot();
+      if (current.queries[0] == 0)
+        glGenQueries(GPU_SECTIONS, current.queries);
+      else if (frame >= 2)
+        resolve(current);
+      current.frame = frame;
+      std::fill(current.milliseconds, current.milliseconds + PROFILE_SECTIONS, 0.);
+      std::fill(current.issued, current.issued + GPU_SECTIONS, false);
+    }
+
+    void endFrame() {
+      slot().milliseconds[CpuFrame] = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+      ++frame;
+    }
+
+    void addCpu(const ProfileSection& section, const double& milliseconds) {
+      slot().milliseconds[section] += milliseconds;
+    }
+
+    //Precondition: no other GPU section is open
+    void beginGpu(const ProfileSection& section) {
+      FrameSlot& current = slot();
+      if (current.queries[0] == 0)
+        return;
+      current.issued[section - FIRST_GPU_SECTION] = true;
+      glBeginQuery(GL_TIME_ELAPSED, current.queries[section - FIRST_GPU_SECTION]);
+    }
+
+    void endGpu() {
+      if (slot().queries[0] != 0)
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    void printStatistics() {
+      std::cout << "[SPAM]: Frame profile (p50 / p99 of the last " << PROFILER_WINDOW << " frames):\n";
+      for (int section = 0; section < PROFILE_SECTIONS; ++section) {
+        std::cout << "  " << PROFILE_SECTION_NAMES[section] << ": ";
+        if (history[section].empty())
+          std::cout << "no samples.\n";
+        else
+          std::cout << percentile(history[section], 0.5) << " / " << percentile(history[section], 0.99) << " ms.\n";
+      }
+    }
+
+    //One row per frame, written when its GPU times arrive
+    bool startCsv(const std::string& fileName) {
+      if (csv.is_open())
+        return true;
+      csv.open(fileName);
+      if (!csv.is_open()) {
+        std::cerr << "[ERROR]: Can not write " << fileName << ".\n";
+        return false;
+      }
+      csv << "frame";
+      for (int section = 0; section < PROFILE_SECTIONS; ++section)
+        csv << "," << PROFILE_SECTION_NAMES[section] << "_ms";
+      csv << "\n";
+      std::cout << "[SPAM]: Writing frame times to " << fileName << ".\n";
+      return true;
+    }
+
+    void stopCsv() {
+      if (!csv.is_open())
+        return;
+      csv.close();
+      std::cout << "[SPAM]: Frame times written.\n";
+    }
+  };
+
+  //Adds the time of its scope to a CPU section of profiler, nothing if profiler is nullptr
+  class ScopedTimer {
+  private:
+    FrameProfiler* profiler;
+    ProfileSection section;
+    std::chrono::steady_clock::time_point start;
+  public:
+    ScopedTimer(FrameProfiler* frameProfiler, const ProfileSection& cpuSection)
+      : profiler(frameProfiler), section(cpuSection), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+      if (profiler != nullptr)
+        profiler->addCpu(section, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+  };
+}
+
+#endif//PROFILER_HPP_
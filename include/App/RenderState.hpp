@@ -0,0 +1,76 @@
+#ifndef RENDER_STATE_HPP_
+#define RENDER_STATE_HPP_
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+namespace tool {
+  //Program, vertex array and textures (unit 0) bound in the current context. Every bind of the app goes
+  //through here, so a bind of what is already bound is skipped and counted
+  class RenderState {
+  private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    GLuint program = UNKNOWN, vertexArray = UNKNOWN;
+    GLuint textures[3] = { UNKNOWN, UNKNOWN, UNKNOWN };//GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP
+    uint64_t issued = 0, filtered = 0;
+
+    static int textureSlot(const GLenum& target) {
+      switch (target) {
+      case GL_TEXTURE_2D_ARRAY:
+        return 1;
+      case GL_TEXTURE_CUBE_MAP:
+        return 2;
+      default:
+        return 0;
+      }
+    }
+
+    bool changes(GLuint& bound, const GLuint& id) {
+      if (bound == id) {
+        ++filtered;
+        return false;
+      }
+      bound = id;
+      ++issued;
+      return true;
+    }
+
+  public:
+    void useProgram(const GLuint& id) {
+      if (changes(program, id))
+        glUseProgram(id);
+    }
+
+    void bindVertexArray(const GLuint& id) {
+      if (changes(vertexArray, id))
+        glBindVertexArray(id);
+    }
+
+    void bindTexture(const GLenum& target, const GLuint& id) {
+      if (changes(textures[textureSlot(target)], id))
+        glBindTexture(target, id);
+    }
+
+    //After deleting GL objects (their names can be reused) or binding without RenderState
+    void forget() {
+      program = vertexArray = UNKNOWN;
+      textures[0] = textures[1] = textures[2] = UNKNOWN;
+    }
+
+    uint64_t issuedCalls() const { return issued; }
+    uint64_t filteredCalls() const { return filtered; }
+
+    void resetCounters() {
+      issued = filtered = 0;
+    }
+  };
+
+  //The app draws in one context
+  RenderState& renderState() {
+    static RenderState state;
+    return state;
+  }
+}
+
+#endif//RENDER_STATE_HPP_
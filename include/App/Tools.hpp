@@ -8,6 +8,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "MemShader.hpp"
+#include "RubikSolverPocket/RubikSolver.h"
 #include "Tools/imageLoader.h"
 
 #include <array>
@@ -28,16 +29,73 @@ namespace tool {
 	class Texture {
 	private:
 		GLuint textureID;
+		int32_t layer = -1;//In a TextureArray, -1 if none
 	public:
 		void loadImageFromFile(const char* fileName);
 		void loadSkyBoxFromFile(const std::vector<std::string>& fileNames);
 		void apply();
 		void skyboxModeApply();
+		void setLayer(const int32_t& index) { layer = index; }
+		int32_t getLayer() const { return layer; }
+		GLuint getID() const { return textureID; }
 	};
 
+	//GL_TEXTURE_2D_ARRAY, layer i loaded from fileNames[i]; every image must have the size of the first one
+	class TextureArray {
+	private:
+		GLuint textureID = 0;
+	public:
+		~TextureArray() {
+			if (textureID != 0)
+				glDeleteTextures(1, &textureID);
+			renderState().forget();
+		}
+		void loadImagesFromFiles(const std::vector<std::string>& fileNames);
+		void apply();
+		GLuint getID() const { return textureID; }
+	};
+
+	void TextureArray::loadImagesFromFiles(const std::vector<std::string>& fileNames) {
+		glGenTextures(1, &textureID);
+		renderState().bindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		int32_t width = 0, height = 0;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);//Rows of 3 bytes per texel
+		stbi_set_flip_vertically_on_load(true);
+		for (std::size_t i = 0; i < fileNames.size(); ++i) {
+			int32_t w, h, nrChannels;
+			uint8_t* data = stbi_load(fileNames[i].c_str(), &w, &h, &nrChannels, 3);
+			if (!data) {
+				std::cerr << "[ERROR]: Failed to load texture layer " << fileNames[i] << std::endl;
+				continue;
+			}
+			if (width == 0) {
+				width = w;
+				height = h;
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, width, height, GLsizei(fileNames.size()), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+			}
+			if (w == width && h == height)
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(i), width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
+			else
+				std::cerr << "[ERROR]: Texture layer " << fileNames[i] << " is not " << width << 'x' << height << std::endl;
+			stbi_image_free(data);
+		}
+		std::cout << "[SPAM]: " << fileNames.size() << " texture layers loaded.\n";
+	}
+
+	void TextureArray::apply() {
+		renderState().bindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	}
+
 	void Texture::loadSkyBoxFromFile(const std::vector<std::string>& fileNames) {
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		renderState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 		int32_t width, height, nrChannels;
 		for (uint32_t i = 0; i < fileNames.size(); i++) {
 			uint8_t* data = stbi_load(fileNames[i].c_str(), &width, &height, &nrChannels, 0);
@@ -60,7 +118,7 @@ namespace tool {
 
 	void Texture::loadImageFromFile(const char* fileName) {
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		renderState().bindTexture(GL_TEXTURE_2D, textureID);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -85,14 +143,14 @@ namespace tool {
 	}
 
 	void Texture::apply() {
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		renderState().bindTexture(GL_TEXTURE_2D, textureID);
 	}
 
 	void Texture::skyboxModeApply() {
-		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		renderState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 	}
 
-	void randomShuffle(std::vector<char>& steps, const int& iterations) {
+	void randomShuffle(rubik::MoveSequence& steps, const int& iterations) {
 		steps.clear();
 		char indexes[6] = { 'R','L','F','B','U','D' };
 		std::map<char, std::array<char, 10>> movements = {{'R',{'L','l','F','f','B','b','U','u','D','d'}},
@@ -106,11 +164,14 @@ namespace tool {
 			steps.push_back(movIdx = movements[std::toupper(movIdx)][rand() % 10]);
 	}
 
-	void fixSequenceLogic(std::vector<char>& sequence) {
+	//Sequence: std::vector<char> or rubik::MoveSequence
+	template <class Sequence>
+	void fixSequenceLogic(Sequence& sequence) {
 		if (!sequence.empty()) {
 			char lastMovement = sequence[0];
 			uint8_t matching = 1;
-			std::vector<char> fixedSequence = {lastMovement};
+			Sequence fixedSequence;
+			fixedSequence.push_back(lastMovement);
 			for (std::size_t idx = 1; idx < sequence.size(); ++idx) {
 				if (sequence[idx] != lastMovement) {
 					matching = 1;
@@ -145,29 +206,44 @@ namespace tool {
 		}
 	}
 
-	void concatenateToSequence(std::vector<char>& sequence, const std::string& pattern, const uint8_t& times) {
+	void concatenateToSequence(rubik::MoveSequence& sequence, const std::string& pattern, const uint8_t& times) {
 		for (uint8_t i = 1; i <= times; ++i)
 			for (auto c : pattern)
 				sequence.push_back(c);
 	}
 
-	std::vector<char> generateFixerSequence(std::vector<std::pair<char, int>>& wrongCenters) {
-		std::map<char, std::string> fixerMovements90 = { {'r',"fBrFbD"},{'l',"fBLFbd"},{'f',"lRfLrD"},
+	//Smallest multiple of the order of fixer (every piece back) that leaves the center of face
+	//turned "turns" times as much as a single repetition does
+	uint8_t fixerRepetitions(const std::string& fixer, const char& face, const int& turns) {
+		int order = int(rubik::CubieState::fromMoves(fixer).order()), quarters = 0;
+		for (auto c : fixer)
+			if (std::tolower(c) == face)
+				quarters += (std::isupper(c)) ? 1 : -1;
+		for (int repetitions = order; repetitions <= 4 * order; repetitions += order)
+			if ((repetitions - turns) * quarters % 4 == 0)
+				return uint8_t(repetitions);
+		std::cerr << "[ERROR]: Fixer " << fixer << " can not turn its center.\n";
+		return 0;
+	}
+
+	rubik::MoveSequence generateFixerSequence(std::vector<std::pair<char, int>>& wrongCenters) {
+		std::map<char, std::string> fixerMovements90 = { {'r',"fBrFbD"},{'l',"FbLfBd"},{'f',"lRfLrD"},
 																										 {'b',"LrBlRd"},{'u',"LrulRB"},{'d',"fBdFbL"} };
 			
-		std::map<char, std::string> fixerMovements180 = { {'r',"BRbR"},{'l',"FlFl"},{'f',"RFrF"},
+		std::map<char, std::string> fixerMovements180 = { {'r',"BRbR"},{'l',"FLfL"},{'f',"RFrF"},
 																											{'b',"LBlB"},{'u',"LUlU"},{'d',"RDrD"} };
-		std::vector<char> fixerSequence;
+		rubik::MoveSequence fixerSequence;
 		for (auto& item : wrongCenters) {
+			const std::string& fixer90 = fixerMovements90[item.first], & fixer180 = fixerMovements180[item.first];
 			if (item.second == 90.f) {//90
-				concatenateToSequence(fixerSequence, fixerMovements90[item.first], 15);
+				concatenateToSequence(fixerSequence, fixer90, fixerRepetitions(fixer90, item.first, 3));
 			}
 			else if (item.second == 180.f) {//180
-				concatenateToSequence(fixerSequence, fixerMovements180[item.first], 5);
+				concatenateToSequence(fixerSequence, fixer180, fixerRepetitions(fixer180, item.first, 1));
 			}
 			else {//180 + 90
-				concatenateToSequence(fixerSequence, fixerMovements180[item.first], 5);
-				concatenateToSequence(fixerSequence, fixerMovements90[item.first], 15);
+				concatenateToSequence(fixerSequence, fixer180, fixerRepetitions(fixer180, item.first, 1));
+				concatenateToSequence(fixerSequence, fixer90, fixerRepetitions(fixer90, item.first, 3));
 			}
 		}
 		return fixerSequence;
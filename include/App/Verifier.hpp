@@ -0,0 +1,183 @@
+#ifndef VERIFIER_HPP_
+#define VERIFIER_HPP_
+
+#include "GL3DEngine.hpp"
+#include "RubikSolverPocket/RubikSolver.h"
+
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#define VERIFIER_SCRAMBLE_LENGTH 30
+
+namespace app {
+	//Headless differential check: solver stickers against the cubies of the engine, no context needed
+	class SolverEngineVerifier {
+	private:
+		struct StickerPlace {
+			glm::vec3 position, normal;
+		};
+		std::array<StickerPlace, 48> places;
+		std::array<char, 48> solvedColours;
+		std::array<int, 27 * 27> placeIndex;//position code * 27 + normal code -> sticker
+		std::mutex reportMutex;
+
+		static int code(const glm::vec3& v) {
+			return int(std::lround(v[0]) + 1) * 9 + int(std::lround(v[1]) + 1) * 3 + int(std::lround(v[2]) + 1);
+		}
+
+		//Edges (up, down) and then corners (up, left, right)
+		static std::array<char, 48> stickers(const algo::Rubik& cube) {
+			std::array<char, 48> result;
+			for (int i = 0; i < 12; ++i) {
+				result[2 * i] = cube.getEdge(i).up;
+				result[2 * i + 1] = cube.getEdge(i).down;
+			}
+			for (int i = 0; i < 8; ++i) {
+				result[24 + 3 * i] = cube.getCorner(i).up;
+				result[24 + 3 * i + 1] = cube.getCorner(i).left;
+				result[24 + 3 * i + 2] = cube.getCorner(i).right;
+			}
+			return result;
+		}
+
+		static void buildEngineCube(std::vector<eng::Cube3D>& body, std::vector<glm::vec3>& origin) {
+			std::size_t idx = 0;
+			for (float x = -1.f; x < 2.f; x += 1.f) {
+				for (float y = -1.f; y < 2.f; y += 1.f) {
+					for (float z = -1.f; z < 2.f; z += 1.f) {
+						if (x != 0.f || y != 0.f || z != 0.f) {
+							origin[idx] = glm::vec3(x, y, z);
+							body[idx++].translate(glm::vec3(x, y, z));
+						}
+					}
+				}
+			}
+		}
+
+		//Same steps as RubikCube3D::execAnimations, without the intermediate frames
+		static void applyMovements(std::vector<eng::Cube3D>& body, std::vector<char>& moves) {
+			for (auto& movement : eng::parseSolverOutput(moves)) {
+				glm::vec3 center = eng::axisVector(eng::describeLayer(movement.first));
+				glm::vec3 axis = glm::abs(center);
+				for (auto& cubie : body) {
+					if (cubie.belongingTo(movement.first)) {
+						cubie.setAnimatedEnable(true, movement.second);
+						cubie.rotateAround(movement.second, center, axis);
+						cubie.updateMembership(axis);
+						cubie.setAnimatedEnable(false, 0.f);
+					}
+				}
+			}
+		}
+
+		bool engineStickers(std::vector<eng::Cube3D>& body, const std::vector<glm::vec3>& origin, std::array<char, 48>& result) {
+			std::array<int, 27> cubieAt;
+			cubieAt.fill(-1);
+			for (std::size_t i = 0; i < body.size(); ++i)
+				cubieAt[code(body[i].getCurrentMembership())] = int(i);
+			for (std::size_t k = 0; k < places.size(); ++k) {
+				int i = cubieAt[code(places[k].position)];
+				if (i < 0)
+					return false;
+				//Normal before any movement: transposed rotation of the model
+				const glm::mat4& model = body[i].getModel();
+				glm::vec3 normal = places[k].normal, original;
+				for (int c = 0; c < 3; ++c)
+					original[c] = model[c][0] * normal[0] + model[c][1] * normal[1] + model[c][2] * normal[2];
+				int sticker = placeIndex[code(origin[i]) * 27 + code(original)];
+				if (sticker < 0)
+					return false;
+				result[k] = solvedColours[sticker];
+			}
+			return true;
+		}
+
+		bool verifyCase(std::mt19937& rng, const char& method, std::string& report) {
+			static const char moves[] = "RrLlFfBbUuDd";
+			std::vector<char> mix(VERIFIER_SCRAMBLE_LENGTH), solution;
+			for (auto& mov : mix)
+				mov = moves[rng() % 12];
+			algo::Rubik cube, replay;
+			cube.movSolver(mix);
+			algo::Rubik aux(cube);
+			aux.solve(solution, method);
+			replay = cube;
+			replay.movSolver(solution);
+
+			std::vector<eng::Cube3D> body(26);
+			std::vector<glm::vec3> origin(26);
+			std::array<char, 48> engine;
+			buildEngineCube(body, origin);
+			applyMovements(body, mix);
+			if (!engineStickers(body, origin, engine) || engine != stickers(cube))
+				report = "engine and solver disagree after the scramble";
+			else {
+				applyMovements(body, solution);
+				if (!replay.isSolved())
+					report = "solver is not solved by its own solution";
+				else if (!engineStickers(body, origin, engine) || engine != stickers(replay))
+					report = "engine and solver disagree after the solution";
+			}
+			if (report.empty())
+				return true;
+			report += "\n\tScramble: " + std::string(mix.begin(), mix.end());
+			report += "\n\tSolution: " + std::string(solution.begin(), solution.end());
+			return false;
+		}
+
+	public:
+		SolverEngineVerifier() {
+			const algo::Rubik solved;
+			glm::vec3 normals[6];
+			int faceOf[48];
+			solvedColours = stickers(solved);
+			for (const eng::MoveDescriptor& descriptor : eng::MOVE_TABLE)
+				normals[descriptor.face] = eng::axisVector(descriptor);
+			for (int k = 0; k < 48; ++k)
+				for (int f = 0; f < 6; ++f)
+					if (solvedColours[k] == solved.getCenter(f).center)
+						faceOf[k] = f;
+			placeIndex.fill(-1);
+			for (int k = 0; k < 48; ++k) {
+				int first = (k < 24) ? k - k % 2 : k - (k - 24) % 3, size = (k < 24) ? 2 : 3;
+				glm::vec3 position(0.f);
+				for (int i = first; i < first + size; ++i)
+					position = position + normals[faceOf[i]];
+				places[k].position = position;
+				places[k].normal = normals[faceOf[k]];
+				placeIndex[code(position) * 27 + code(places[k].normal)] = k;
+			}
+		}
+
+		//Returns the number of failed cases, the first one is printed
+		std::size_t run(const std::size_t& cases, const char& method = 'B', unsigned int threads = 0, const unsigned int& seed = 0) {
+			std::atomic<std::size_t> next{ 0 }, failures{ 0 };
+			auto worker = [&](unsigned int id) {
+				std::mt19937 rng(seed * 7919u + id);
+				for (std::size_t i = next++; i < cases; i = next++) {
+					std::string report;
+					if (!verifyCase(rng, method, report) && failures++ == 0) {
+						std::lock_guard<std::mutex> lock(reportMutex);
+						std::cerr << "[ERROR]: Case " << i << ", " << report << std::endl;
+					}
+				}
+			};
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			std::vector<std::thread> pool;
+			for (unsigned int id = 1; id < threads; ++id)
+				pool.emplace_back(worker, id);
+			worker(0);
+			for (auto& t : pool)
+				t.join();
+			std::cout << "[SPAM]: " << cases << " cases verified on " << threads << " threads, " << failures << " failures.\n";
+			return failures;
+		}
+	};
+}
+
+#endif
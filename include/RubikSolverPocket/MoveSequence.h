@@ -0,0 +1,184 @@
+/**
+  * @file MoveSequence.h
+  * @brief Packed sequence of movements, 4 bits per movement
+  *
+  */
+#ifndef MOVE_SEQUENCE_H_
+#define MOVE_SEQUENCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace rubik {
+
+  /**
+   * @class MoveSequence
+   * @brief Movements RrLlFfBbUuDd packed 16 per word, the first INLINE_WORDS words inside the object
+   * \note Code of a movement: 2 * face + (prime ? 1 : 0), faces in the order R L F B U D
+   *
+   */
+  class MoveSequence {
+  public:
+    static const size_t INLINE_WORDS = 4;
+    static const size_t MOVES_PER_WORD = 16;
+
+    /**
+      * @class const_iterator
+      * @brief Input iterator that decodes a movement on each dereference
+      *
+      */
+    class const_iterator {
+    public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef char value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const char* pointer;
+      typedef char reference;
+
+      const_iterator(const uint64_t* words, size_t index) : words(words), index(index) {}
+      char operator * () const { return decode(words, index); }
+      const_iterator& operator ++ () { ++index; return *this; }
+      const_iterator operator ++ (int) { const_iterator old(*this); ++index; return old; }
+      bool operator == (const const_iterator& it) const { return index == it.index; }
+      bool operator != (const const_iterator& it) const { return index != it.index; }
+
+    private:
+      const uint64_t* words;
+      size_t index;
+    };
+
+    MoveSequence() : heap(nullptr), length(0), capacityWords(INLINE_WORDS) {}
+    MoveSequence(const char* sec) : MoveSequence() { append(sec); }
+    MoveSequence(const std::vector<char>& moves) : MoveSequence() { append(moves.begin(), moves.end()); }
+    MoveSequence(const MoveSequence& seq) : MoveSequence() { *this = seq; }
+    MoveSequence(MoveSequence&& seq) noexcept : MoveSequence() { *this = std::move(seq); }
+    ~MoveSequence() { delete[] heap; }
+
+    MoveSequence& operator = (const MoveSequence& seq) {
+      if (this != &seq) {
+        length = 0;
+        reserve(seq.length);
+        memcpy(data(), seq.data(), wordsFor(seq.length) * sizeof(uint64_t));
+        length = seq.length;
+      }
+      return *this;
+    }
+    MoveSequence& operator = (MoveSequence&& seq) noexcept {
+      if (this != &seq) {
+        delete[] heap;
+        heap = seq.heap;
+        capacityWords = seq.capacityWords;
+        length = seq.length;
+        memcpy(local, seq.local, sizeof(local));
+        seq.heap = nullptr;
+        seq.capacityWords = INLINE_WORDS;
+        seq.length = 0;
+      }
+      return *this;
+    }
+
+    /**
+      * @brief Code of a movement
+      * @param const char& mov
+      * @return int -1 if mov is not one of RrLlFfBbUuDd
+      *
+      */
+    static constexpr int code(const char& mov) {
+      for (int c = 0; c < 12; ++c)
+        if (notation(c) == mov)
+          return c;
+      return -1;
+    }
+
+    /**
+      * @brief Movement of a code, inverse of code()
+      * @param const int& c
+      * @return char
+      * @pre 0 <= c < 12
+      *
+      */
+    static constexpr char notation(const int& c) {
+      return "RrLlFfBbUuDd"[c];
+    }
+
+    /**
+      * @brief Append a movement, invalid ones are reported and ignored
+      * @param const char& mov
+      * @return void
+      *
+      */
+    void push_back(const char& mov) {
+      int c = code(mov);
+      if (c < 0) {
+        std::cerr << "Error: invalid movement " << mov << std::endl;
+        return;
+      }
+      reserve(length + 1);
+      uint64_t& word = data()[length / MOVES_PER_WORD];
+      const unsigned int shift = 4 * (length % MOVES_PER_WORD);
+      word = (word & ~(uint64_t(0xF) << shift)) | (uint64_t(c) << shift);
+      ++length;
+    }
+    void append(const char* sec) {
+      for (; *sec != '\0'; ++sec)
+        push_back(*sec);
+    }
+    template <class Iterator>
+    void append(Iterator first, Iterator last) {
+      for (; first != last; ++first)
+        push_back(*first);
+    }
+    void pop_back() { --length; }
+    void clear() { length = 0; }
+
+    /**
+      * @brief Capacity for n movements, inline storage while n <= INLINE_WORDS * MOVES_PER_WORD
+      * @param size_t n
+      * @return void
+      *
+      */
+    void reserve(size_t n) {
+      if (wordsFor(n) > capacityWords) {
+        size_t words = std::max(wordsFor(n), 2 * capacityWords);
+        uint64_t* grown = new uint64_t[words];
+        memcpy(grown, data(), wordsFor(length) * sizeof(uint64_t));
+        delete[] heap;
+        heap = grown;
+        capacityWords = words;
+      }
+    }
+
+    char operator [] (size_t i) const { return decode(data(), i); }
+    char back() const { return decode(data(), length - 1); }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const_iterator begin() const { return const_iterator(data(), 0); }
+    const_iterator end() const { return const_iterator(data(), length); }
+
+  private:
+    uint64_t local[INLINE_WORDS] = {};
+    uint64_t* heap;
+    size_t length, capacityWords;
+
+    static size_t wordsFor(size_t n) { return (n + MOVES_PER_WORD - 1) / MOVES_PER_WORD; }
+    static char decode(const uint64_t* words, size_t i) {
+      return notation(int((words[i / MOVES_PER_WORD] >> (4 * (i % MOVES_PER_WORD))) & 0xF));
+    }
+    uint64_t* data() { return heap ? heap : local; }
+    const uint64_t* data() const { return heap ? heap : local; }
+  };
+
+  inline std::ostream& operator << (std::ostream& os, const MoveSequence& seq) {
+    for (char mov : seq)
+      os << mov;
+    return os;
+  }
+}
+
+#endif
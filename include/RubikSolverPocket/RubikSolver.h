@@ -9,10 +9,18 @@
 #ifndef RUBIK_SOLVER_H_
 #define RUBIK_SOLVER_H_
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "RubikSolverPocket/MoveSequence.h"
+
 using namespace std;
 
 namespace rubik {
@@ -44,6 +52,87 @@ namespace rubik {
     char up, left, right;
   };
 
+  /**
+   * @struct LastLayerCase
+   * @brief Entry of the last layer tables
+   * \note auf is the number of bottom quarter turns before the algorithm
+   *
+   */
+  struct LastLayerCase {
+    const char* algorithm;
+    int auf;
+  };
+
+  /**
+   * @struct Symmetry
+   * @brief Whole cube rotation, with the colours renamed to keep the centers
+   * \note face[i] is the image of center i, sticker[i] the image of sticker i
+   *
+   */
+  struct Symmetry {
+    int face[6];
+    int sticker[48];
+  };
+
+  /**
+   * @struct SearchBudget
+   * @brief Limits of a search: deadline and cancellation token
+   *
+   */
+  struct SearchBudget {
+    chrono::steady_clock::time_point deadline;
+    const atomic<bool>* cancel;
+
+    /**
+      * @brief Check if the search must stop
+      * @return bool
+      *
+      */
+    bool exhausted() const;
+  };
+
+  /**
+   * @struct SearchArena
+   * @brief Buffers and node stack of the searches of a thread, reused by every solve
+   * \note Defined in RubikSolver.cpp
+   *
+   */
+  struct SearchArena;
+
+  /**
+   * @enum SolveStatus
+   * @brief Result of a solve with deadline
+   * \note Optimal: the method finished, BudgetLimited: deadline reached,
+   *  Cancelled: stopped early by the token. The solution is always valid.
+   *
+   */
+  enum SolveStatus { Optimal, BudgetLimited, Cancelled };
+
+  /**
+   * @enum Phase
+   * @brief Phases of the beginners method, index of the instrumentation counters
+   *
+   */
+  enum Phase { WhiteCross, CornersFirstStep, SecondStep, OrientLastLayer, PermuteLastLayer, PHASES };
+
+  /**
+   * @struct PhaseCounters
+   * @brief Instrumentation of a phase: runs, wall time, movements emitted,
+   *  searchEdge()/searchCorner() calls, sequence() calls and its loop iterations
+   * \note Per thread, only updated when compiled with RUBIK_INSTRUMENTATION
+   *
+   */
+  struct PhaseCounters {
+    unsigned long runs, moves, searchEdgeCalls, searchCornerCalls, sequences, iterations;
+    double seconds;
+  };
+
+  /**
+   * @brief Receiver of the movements of each phase, called as soon as the phase is found
+   *
+   */
+  typedef function<void(const char* phase, const vector<char>& moves)> PhaseCallback;
+
   /**
    * @class Class to interact with an instance of Rubik's Cube
    *
@@ -122,15 +211,15 @@ namespace rubik {
     int searchCorner(const char& a, const char& iz, const char& de) const;
 
     /**
-      * @brief Execution of sec.size() movements in string sec
-      * @param string sec string with movements
+      * @brief Execution of strlen(sec) movements in string sec
+      * @param const char* sec string with movements
       * @param vector<char>& solution where we will append movements from sec
       * @return void
       * @pre Valid chars in string
       * @see explainMovements()
       *
       */
-    void sequence(const string& sec, vector<char>& solution);
+    void sequence(const char* sec, vector<char>& solution);
 
 
 
@@ -188,41 +277,126 @@ namespace rubik {
 
 
     /**
-      * @brief First part of bottom face
+      * @brief Orientation of the bottom face in a single algorithm (OLL)
       * @param vector<char>& solution
       * @return void
+      * @pre secondStep()
       * @see thirdStep()
       *
       */
-    void yellowCross(vector<char>& solution);
+    void orientLastLayer(vector<char>& solution);
 
     /**
-      * @brief Last four corners
+      * @brief Permutation of the bottom layer in a single algorithm (PLL)
       * @param vector<char>& solution
       * @return void
-      * @pre yellowCross()
+      * @pre orientLastLayer()
+      * @see thirdStep()
       *
       */
-    void finalCorners(vector<char>& solution);
+    void permuteLastLayer(vector<char>& solution);
 
     /**
-      * @brief It moves corner to their position
+      * @brief Turn the bottom layer a number of quarters (AUF)
+      * @param const int& turns
       * @param vector<char>& solution
       * @return void
-      * @see finalCorners()
+      * @pre turns in [0, 3]
       *
       */
-    void permutationFinalCorners(vector<char>& solution);
+    void alignLastLayer(const int& turns, vector<char>& solution);
 
     /**
-      * @brief Last step
-      * @param vector<char>& solution
+      * @brief Hash of the orientation of bottom layer stickers
+      * @return int
+      * @retval 0 bottom face completed
+      *
+      */
+    int orientationKey() const;
+
+    /**
+      * @brief Hash of the permutation of bottom layer stickers
+      * @return int
+      * @pre Bottom face completed
+      *
+      */
+    int permutationKey() const;
+
+    /**
+      * @brief Table of OLL cases, indexed by orientationKey()
+      * @return const unordered_map<int, LastLayerCase>&
+      * \note Built on first use, with every AUF of each case
+      *
+      */
+    static const unordered_map<int, LastLayerCase>& orientationCases();
+
+    /**
+      * @brief Table of PLL cases, indexed by permutationKey()
+      * @return const unordered_map<int, LastLayerCase>&
+      * \note Built on first use, with every AUF of each case
+      *
+      */
+    static const unordered_map<int, LastLayerCase>& permutationCases();
+
+    /**
+      * @brief Depth first search over the prefixes of improveSolution()
+      * @param SearchArena& arena The node searched is arena.nodes[arena.prefix.size()]
+      * @param const int& depth Movements left to append to arena.prefix
+      * @param vector<char>& best, it's modified
+      * @param const SearchBudget& budget
+      * @return bool
+      * @retval true best was modified
+      * @pre arena.prefix.size() + depth <= SEARCH_MAX_DEPTH
+      * @see improveSolution()
+      *
+      */
+    static bool searchPrefix(SearchArena& arena, const int& depth, vector<char>& best, const SearchBudget& budget);
+
+    /**
+      * @brief Search memory of the calling thread, reserved on first use
+      * @return SearchArena&
+      *
+      */
+    static SearchArena& arena();
+
+    /**
+      * @brief Execution of a single movement
+      * @param const char& mov One of RrLlFfBbUuDd, others are ignored
+      * @param vector<char>& solution where we will append mov
       * @return void
-      * @pre permutationFinalCorners()
-      * @see
       *
       */
-    void positionFinalCorners(vector<char>& solution);
+    void turn(const char& mov, vector<char>& solution);
+
+    /**
+      * @brief Rename the stickers of each piece as the solved piece placed
+      *  where target has it (composition with the inverse of target)
+      * @param const Rubik& target
+      * @param Rubik& result, it's modified
+      * @return bool
+      * @retval false a piece of *this is not in target
+      * @see solveBetween()
+      *
+      */
+    bool relabel(const Rubik& target, Rubik& result) const;
+
+    /**
+      * @brief Sticker by index, edges (up, down) and then corners (up, left, right)
+      * @param const int& index
+      * @return char&
+      * @pre index in [0, 47]
+      *
+      */
+    char& sticker(const int& index);
+    char sticker(const int& index) const;
+
+    /**
+      * @brief Table of the 24 symmetries, the identity first
+      * @return const vector<Symmetry>&
+      * \note Built on first use from the solved cube
+      *
+      */
+    static const vector<Symmetry>& symmetries();
 
   public:
     /**
@@ -450,13 +624,167 @@ namespace rubik {
     /**
       * @brief It solves rubik cube with private auxiliary functions
       * @param vector<char>& solution
+      * @param const char& method 'B' beginners, 'S' search over beginners
       * @return void
       * @pre solution empty, it's modified
       * @see solveStepByStep()
+      * @see improveSolution()
       *
       */
     void solve(vector<char>& solution, const char& method = 'B');
 
+    /**
+      * @brief It solves rubik cube sending each phase to a callback
+      * @param const PhaseCallback& emit
+      * @param const char& method
+      * @return void
+      * \note 'B' emits whiteCross, cornersFirstStep, secondStep, orientLastLayer
+      *  and permuteLastLayer, other methods a single "solution" phase
+      * @see solve()
+      *
+      */
+    void solve(const PhaseCallback& emit, const char& method = 'B');
+
+    /**
+      * @brief It solves rubik cube before a deadline, it can be cancelled
+      * @param vector<char>& solution Best solution found
+      * @param const chrono::steady_clock::time_point& deadline
+      * @param const atomic<bool>& cancel Cancellation token
+      * @param const char& method 'B' beginners, 'S' search over beginners
+      * @return SolveStatus
+      * @pre solution empty, it's modified
+      * \note The beginners solution is always found first, 'S' deepens
+      *  until SEARCH_MAX_DEPTH or the budget is exhausted
+      * @see solve()
+      *
+      */
+    SolveStatus solve(vector<char>& solution, const chrono::steady_clock::time_point& deadline,
+                      const atomic<bool>& cancel, const char& method = 'S');
+
+    /**
+      * @brief Look for a shorter solution, trying the beginners method
+      *  after every sequence of up to depth movements
+      * @param vector<char>& solution Best known solution, it's modified
+      * @param const int& depth
+      * @param const atomic<bool>& stop Checked before each try
+      * @return bool
+      * @retval true A shorter solution was found
+      * \note Rubik is not modified
+      *
+      */
+    bool improveSolution(vector<char>& solution, const int& depth, const atomic<bool>& stop) const;
+
+    /**
+      * @brief It solves the 24 symmetric cubes in parallel and keeps the shortest solution
+      * @param vector<char>& solution
+      * @param const char& method
+      * @param const unsigned int& threads, 0 uses every core
+      * @return void
+      * @pre solution empty, it's modified
+      * \note Colour neutral: the first face is not always the white one
+      * @see symmetric()
+      *
+      */
+    void solveColourNeutral(vector<char>& solution, const char& method = 'B', const unsigned int& threads = 0);
+
+    /**
+      * @brief Remove redundant movements (Xx, XXX) from a sequence
+      * @param vector<char>& moves, it's modified
+      * @return void
+      *
+      */
+    static void simplify(vector<char>& moves);
+
+
+    // Instrumentation
+    /**
+      * @brief Counters of a phase, in the calling thread
+      * @param const Phase& phase
+      * @return const PhaseCounters&
+      * @pre phase < PHASES
+      *
+      */
+    static const PhaseCounters& counters(const Phase& phase);
+
+    /**
+      * @brief Set every counter of the calling thread to zero
+      * @return void
+      *
+      */
+    static void resetCounters();
+
+    /**
+      * @brief Export the counters of the calling thread in JSON
+      * @param std::ostream& os
+      * @return void
+      * \note "enabled" is false without RUBIK_INSTRUMENTATION
+      *
+      */
+    static void exportCounters(std::ostream& os = cout);
+
+    /**
+      * @brief Heap allocations made by the search arena of the calling thread
+      * @return unsigned long
+      * \note The first solve reserves the arena, a warm search does not allocate
+      *
+      */
+    static unsigned long arenaAllocations();
+
+    /**
+      * @brief It solves the way from a state to another one with a single solve
+      * @param const Rubik& from
+      * @param const Rubik& to
+      * @param vector<char>& solution, it's modified
+      * @param const char& method
+      * @return bool
+      * @retval false from and to don't have the same centers and pieces
+      * \note from is relabelled so that to becomes the solved cube
+      * @see relabel()
+      *
+      */
+    static bool solveBetween(const Rubik& from, const Rubik& to, vector<char>& solution, const char& method = 'B');
+
+
+    // Symmetries
+    /**
+      * @brief Rubik's cube rotated and recoloured
+      * @param const int& symmetry
+      * @return Rubik
+      * @pre symmetry in [0, 23]
+      * @see Symmetry
+      *
+      */
+    Rubik symmetric(const int& symmetry) const;
+
+    /**
+      * @brief Smallest sticker string of the 24 symmetric cubes
+      * @param int& symmetry, it's modified with the symmetry used
+      * @return string
+      * \note Equivalent cubes have the same key
+      * @see symmetric()
+      *
+      */
+    string canonicalKey(int& symmetry) const;
+
+    /**
+      * @brief Rewrite movements through a symmetry
+      * @param vector<char>& moves, it's modified
+      * @param const int& symmetry
+      * @return void
+      * \note If moves solve r, the result solves r.symmetric(symmetry)
+      *
+      */
+    static void symmetricMoves(vector<char>& moves, const int& symmetry);
+
+    /**
+      * @brief Inverse of a symmetry
+      * @param const int& symmetry
+      * @return int
+      * @retval [0, 23]
+      *
+      */
+    static int inverseSymmetry(const int& symmetry);
+
 
     // Input && output
 
@@ -547,6 +875,16 @@ namespace rubik {
       */
     void readRubik(std::istream& is = cin);
 
+    /**
+      * @brief Set every sticker from a buffer, without streams
+      * @param const char* facelets 54 stickers in the order of readRubik(), same chars as readSticker()
+      * @return bool
+      * @retval false there is an invalid char, *this is not modified
+      * \note Like readRubik(), colours are not checked: see logicErrors()
+      *
+      */
+    bool setFacelets(const char* facelets);
+
 
     // Getter
     /**
@@ -620,8 +958,185 @@ namespace rubik {
 
 
     //Add Function
-    void Rubik::movSolver(vector<char>& moves);
+    void movSolver(vector<char>& moves);
+
+    /**
+      * @brief Execution of the packed movements, decoded one at a time
+      * @param const MoveSequence& moves
+      * @return void
+      *
+      */
+    void movSolver(const MoveSequence& moves);
+
+  };
 
+  /**
+   * @struct Cycle
+   * @brief Cycle of pieces in a CubieState
+   * \note orientation is the twist (corners, mod 3) or flip (edges, mod 2) after a turn of the cycle
+   *
+   */
+  struct Cycle {
+    int length, orientation;
+  };
+
+  /**
+   * @struct CubieState
+   * @brief Element of the cube group: permutation and orientation of corners and edges
+   * \note Position i holds the piece cornerPerm[i], twisted cornerOri[i]. Centers are fixed
+   *
+   */
+  struct CubieState {
+    unsigned char cornerPerm[8], cornerOri[8], edgePerm[12], edgeOri[12];
+
+    /**
+      * @brief Solved cube
+      * @return CubieState
+      *
+      */
+    static CubieState identity();
+
+    /**
+      * @brief State reached from the solved cube with a sequence
+      * @param const string& moves
+      * @return CubieState
+      * @pre Valid chars in moves
+      *
+      */
+    static CubieState fromMoves(const string& moves);
+
+    /**
+      * @brief State of a rubik's cube
+      * @param const Rubik& rubik
+      * @return CubieState
+      * @pre rubik.logicErrors() == 0
+      *
+      */
+    static CubieState fromRubik(const Rubik& rubik);
+
+    /**
+      * @brief Check if the state can be reached with movements
+      * @return bool
+      * \note Every piece once (fromRubik() leaves unknown pieces out of range), twists sum 0 mod 3,
+      *  flips sum 0 mod 2 and same parity of corner and edge permutations
+      *
+      */
+    bool solvable() const;
+
+    /**
+      * @brief *this followed by other
+      * @param const CubieState& other
+      * @return CubieState
+      *
+      */
+    CubieState compose(const CubieState& other) const;
+
+    /**
+      * @brief State that composed with *this gives the identity
+      * @return CubieState
+      *
+      */
+    CubieState inverse() const;
+
+    /**
+      * @brief *this composed n times, negative n uses inverse()
+      * @param long long n
+      * @return CubieState
+      *
+      */
+    CubieState power(long long n) const;
+
+    /**
+      * @brief Smallest n > 0 with power(n) == identity()
+      * @return unsigned long
+      * @retval [1, 1260]
+      *
+      */
+    unsigned long order() const;
+
+    /**
+      * @brief Cycles of corners and edges, without fixed pieces in place
+      * @param vector<Cycle>& corners, it's modified
+      * @param vector<Cycle>& edges, it's modified
+      * @return void
+      *
+      */
+    void cycleStructure(vector<Cycle>& corners, vector<Cycle>& edges) const;
+
+    bool operator == (const CubieState& other) const;
+    bool operator != (const CubieState& other) const;
+  };
+
+  /**
+   * @class SolutionCache
+   * @brief LRU cache of solutions, indexed by Rubik::canonicalKey()
+   * \note Not thread safe
+   *
+   */
+  class SolutionCache {
+  private:
+    typedef list<pair<string, vector<char> > > Entries;
+
+    /**
+     * @brief Solutions of canonical cubes, the most recent first
+     *
+     */
+    Entries entries;
+    unordered_map<string, Entries::iterator> index;
+    size_t capacity;
+
+  public:
+    size_t hits, misses;
+
+    /**
+      * @brief Constructor with the maximum number of solutions
+      * @param const size_t& capacity
+      *
+      */
+    SolutionCache(const size_t& capacity = 64);
+
+    /**
+      * @brief Same as Rubik::solve(), reusing solutions of equivalent cubes
+      * @param Rubik& rubik, it's solved
+      * @param vector<char>& solution, it's modified
+      * @param const char& method
+      * @param const bool& colourNeutral
+      * @return bool
+      * @retval true The solution came from the cache
+      * @see Rubik::solve()
+      *
+      */
+    bool solve(Rubik& rubik, vector<char>& solution, const char& method = 'B', const bool& colourNeutral = false);
+
+    /**
+      * @brief Look for the solution of an equivalent cube
+      * @param const Rubik& rubik
+      * @param vector<char>& solution, it's modified if found
+      * @param const char& method
+      * @param const bool& colourNeutral
+      * @return bool
+      * @retval true The solution came from the cache
+      *
+      */
+    bool lookup(const Rubik& rubik, vector<char>& solution, const char& method = 'B', const bool& colourNeutral = false);
+
+    /**
+      * @brief Store a solution found outside the cache
+      * @param const Rubik& rubik Cube before the solution
+      * @param const vector<char>& solution
+      * @param const char& method
+      * @param const bool& colourNeutral
+      * @return void
+      *
+      */
+    void insert(const Rubik& rubik, const vector<char>& solution, const char& method = 'B', const bool& colourNeutral = false);
+
+    /**
+      * @brief Remove every solution
+      * @return void
+      *
+      */
+    void clear();
   };
 
   /**
@@ -674,4 +1189,6 @@ namespace rubik {
 
 }
 
+namespace algo = rubik; // Name used by the application
+
 #endif//RUBIK_SOLVER_H_
@@ -0,0 +1,83 @@
+/**
+  * @file RubikSolverC.h
+  * @brief C interface of the solver, for C programs and FFI
+  * \note No function writes to stdout or stderr. After the first call on a thread
+  *  (or rubik_thread_init()) no function allocates
+  *
+  */
+#ifndef RUBIK_SOLVER_C_H_
+#define RUBIK_SOLVER_C_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Stickers of a facelet buffer: faces top, left, front, right, back and bottom, 9 each,
+ *  the order of Rubik::readRubik(). Colours w o g r l y, or 1-6, in any case
+ *
+ */
+#define RUBIK_FACELETS 54
+
+/**
+ * @brief Capacity that fits any solution
+ *
+ */
+#define RUBIK_MAX_MOVES 256
+
+/**
+ * @enum rubik_error
+ * @brief Negative results of the functions
+ *
+ */
+enum rubik_error {
+  RUBIK_OK = 0,
+  RUBIK_ERROR_ARGUMENT = -1,   /* Null pointer or unknown method */
+  RUBIK_ERROR_COLOUR = -2,     /* A facelet is not a colour */
+  RUBIK_ERROR_COUNT = -3,      /* Not 9 stickers of each colour, or repeated centers */
+  RUBIK_ERROR_CENTERS = -4,    /* Centers not in the orientation of the solved cube: top w, front g */
+  RUBIK_ERROR_UNSOLVABLE = -5, /* Unknown piece, twisted corner, flipped edge or swapped pieces */
+  RUBIK_ERROR_CAPACITY = -6    /* The solution does not fit in the output buffer */
+};
+
+/**
+ * @brief Reserve the memory of the calling thread
+ * @return int RUBIK_OK
+ *
+ */
+int rubik_thread_init(void);
+
+/**
+ * @brief Check that a cube can be solved
+ * @param const char* facelets RUBIK_FACELETS chars
+ * @return int RUBIK_OK or a rubik_error
+ *
+ */
+int rubik_validate(const char* facelets);
+
+/**
+ * @brief Solve a cube
+ * @param const char* facelets RUBIK_FACELETS chars
+ * @param char method 'B' beginners method, 'S' shorter search
+ * @param char* moves Movements RrLlFfBbUuDd (lowercase is prime), not terminated by '\0'
+ * @param size_t capacity of moves
+ * @return int Number of movements written, or a rubik_error
+ *
+ */
+int rubik_solve(const char* facelets, char method, char* moves, size_t capacity);
+
+/**
+ * @brief Description of a result
+ * @param int error
+ * @return const char* static string
+ *
+ */
+const char* rubik_error_string(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
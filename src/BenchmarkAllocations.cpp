@@ -0,0 +1,26 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace app {
+  std::atomic<bool> countingAllocations{ false };
+  std::atomic<unsigned long> heapAllocations{ 0 };
+}
+
+// Global allocator of the program, counts only while app::countingAllocations is set (SolverBenchmark::run).
+// The array and nothrow forms call these
+void* operator new(std::size_t size) {
+  if (app::countingAllocations.load(std::memory_order_relaxed))
+    app::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* memory = std::malloc(size != 0 ? size : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
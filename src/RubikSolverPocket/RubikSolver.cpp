@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
@@ -5,6 +6,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <string.h>
+#include <thread>
 #include <vector>
 #include "RubikSolverPocket/RubikSolver.h"
 
@@ -20,8 +22,56 @@ using namespace std;
 #define BT_ON         "\x1b[1m"
 #define INTERMITTENT  "\x1b[42m"
 
+#define SEARCH_DEPTH      2
+#define SYMMETRIES        24
+#define SEARCH_MAX_DEPTH  6
+#define ARENA_MOVES       512
+
 namespace rubik {
 
+  // Instrumentation, per thread to be usable from the parallel solvers
+  static thread_local PhaseCounters phaseCounters[PHASES];
+
+#ifdef RUBIK_INSTRUMENTATION
+  static thread_local int currentPhase = -1;
+
+  class PhaseScope {
+  private:
+    int previous;
+    unsigned long firstMove;
+    const vector<char>& solution;
+    chrono::steady_clock::time_point start;
+
+  public:
+    PhaseScope(const Phase& phase, const vector<char>& solution)
+      : previous(currentPhase), firstMove(solution.size()), solution(solution), start(chrono::steady_clock::now()) {
+      currentPhase = phase;
+    }
+    ~PhaseScope() {
+      PhaseCounters& c = phaseCounters[currentPhase];
+      ++c.runs;
+      c.moves += solution.size() - firstMove;
+      c.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      currentPhase = previous;
+    }
+  };
+  #define PHASE_SCOPE(phase) PhaseScope phaseScope(phase, solution)
+  #define COUNT(counter) do { if (currentPhase >= 0) ++phaseCounters[currentPhase].counter; } while (0)
+#else
+  #define PHASE_SCOPE(phase)
+  #define COUNT(counter)
+#endif
+
+  // Search memory, one per thread: nodes[d] is the cube after the d movements of prefix
+  struct SearchArena {
+    Rubik nodes[SEARCH_MAX_DEPTH + 1];
+    vector<char> prefix, candidate, solution, turns;
+    unsigned long allocations;
+
+    SearchArena();
+    void reserve(vector<char>& buffer, const size_t& size);
+  };
+
   // Auxiliary functions
   void Rubik::explainMovements(vector<char>& solution, unsigned int& movement) const {
     while (movement <= (solution.size() - 1)) {
@@ -73,6 +123,7 @@ namespace rubik {
     return number;
   }
   int Rubik::searchEdge(const char& ar, const char& ab) const {
+    COUNT(searchEdgeCalls);
     int position;
     if ((edge[0].up == ar && edge[0].down == ab) || (edge[0].up == ab && edge[0].down == ar))
       position = 0;
@@ -102,6 +153,7 @@ namespace rubik {
     return position;
   }
   int Rubik::searchCorner(const char& a, const char& iz, const char& de) const {
+    COUNT(searchCornerCalls);
     int position;
     if (((corner[0].up == a) && (corner[0].left == iz) && (corner[0].right == de)) ||
       ((corner[0].up == a) && (corner[0].left == de) && (corner[0].right == iz)) ||
@@ -164,8 +216,10 @@ namespace rubik {
 
     return position;
   }
-  void Rubik::sequence(const string& sec, vector<char>& solution) {
-    for (unsigned int i = 0; i < sec.size(); ++i) {
+  void Rubik::sequence(const char* sec, vector<char>& solution) {
+    COUNT(sequences);
+    for (unsigned int i = 0; sec[i] != '\0'; ++i) {
+      COUNT(iterations);
       if (sec[i] == 'R')
         R(solution);
       else if (sec[i] == 'r')
@@ -201,6 +255,7 @@ namespace rubik {
     cornersFirstStep(solution);
   }
   void Rubik::whiteCross(vector<char>& solution) {
+    PHASE_SCOPE(WhiteCross);
     int position = searchEdge('w', 'g'); // White, green.
     if (position == 0) {
       if (edge[0].down == 'w') // FuRU
@@ -456,6 +511,7 @@ namespace rubik {
     }
   }
   void Rubik::cornersFirstStep(vector<char>& solution) {
+    PHASE_SCOPE(CornersFirstStep);
     int position = searchCorner('w', 'g', 'r'); // White, green and red
     if (position == 0) {
       if (corner[0].up == 'w') // LDlrdR
@@ -629,6 +685,7 @@ namespace rubik {
   }
 
   void Rubik::secondStep(vector<char>& solution) {
+    PHASE_SCOPE(SecondStep);
     int position = searchEdge('g', 'o'); // Green/orange
     if (position == 4) {
       if (edge[4].down == 'g') // dfDF
@@ -833,243 +890,260 @@ namespace rubik {
   }
 
   void Rubik::thirdStep(vector<char>& solution) {
-    yellowCross(solution);
-    finalCorners(solution);
-  }
-  void Rubik::yellowCross(vector<char>& solution) {
-    bool repeat;
-    if ((edge[4].down == 'y') && (edge[5].down == 'y') &&
-      (edge[6].down == 'y') && (edge[7].down == 'y')) 	// LDBdbl && frdRDF Yellow center
-      sequence("LDBdblfrdRDF", solution);
-    else if ((edge[4].down == 'y') && (edge[5].down != 'y') &&
-      (edge[6].down == 'y') && (edge[7].down != 'y')) 	// frdRDF Horizontal line
-      sequence("frdRDF", solution);
-    else if ((edge[4].down != 'y') && (edge[5].down == 'y') &&
-      (edge[6].down != 'y') && (edge[7].down == 'y')) 	// lfdFDL  Vertical line
-      sequence("lfdFDL", solution);
-
-    else if ((edge[4].down != 'y') && (edge[5].down != 'y') &&
-      (edge[6].down == 'y') && (edge[7].down == 'y')) 	// LDBdbl 'L' case
-      sequence("LDBdbl", solution);
-
-    else if ((edge[4].down != 'y') && (edge[5].down == 'y') &&
-      (edge[6].down == 'y') && (edge[7].down != 'y')) 	// BDRdrb '_|' case
-      sequence("BDRdrb", solution);
-    else if ((edge[4].down == 'y') && (edge[5].down == 'y') &&
-      (edge[6].down != 'y') && (edge[7].down != 'y')) 	// RDFdfr '' case
-      sequence("RDFdfr", solution);
-    else if ((edge[4].down == 'y') && (edge[5].down != 'y') &&
-      (edge[6].down != 'y') && (edge[7].down == 'y')) 	// FDLdlf ' ' reverse case
-      sequence("FDLdlf", solution);
-    else {
-      int yellows = 0;
-      int whistleBlower1, whistleBlower2;
-      for (int i = 0; i < 4; ++i) {
-        if (edge[i].up == 'y') {
-          yellows++;
-          whistleBlower2 = i;
-        }
-        else
-          whistleBlower1 = i;
+    orientLastLayer(solution);
+    permuteLastLayer(solution);
+  }
+  void Rubik::orientLastLayer(vector<char>& solution) {
+    PHASE_SCOPE(OrientLastLayer);
+    int key = orientationKey();
+    if (key != 0) {
+      const unordered_map<int, LastLayerCase>& cases = orientationCases();
+      unordered_map<int, LastLayerCase>::const_iterator it = cases.find(key);
+      if (it != cases.end()) {
+        alignLastLayer(it->second.auf, solution);
+        sequence(it->second.algorithm, solution);
       }
-      if (yellows == 3)
-        cout << "This Rubik's cube has no solution, you neew change the orientation of the edge (" << edge[whistleBlower1].up << "," << edge[whistleBlower1].down << ").\n";
-      else if (yellows == 1)
-        cout << "This Rubik's cube has no solution, you neew change the orientation of the edge (" << edge[whistleBlower2].up << "," << edge[whistleBlower2].down << ").\n";
+      else
+        cout << "This Rubik's cube has no solution, you need change the orientation of a piece of the bottom face.\n";
     }
+  }
+  void Rubik::permuteLastLayer(vector<char>& solution) {
+    PHASE_SCOPE(PermuteLastLayer);
+    const unordered_map<int, LastLayerCase>& cases = permutationCases();
+    unordered_map<int, LastLayerCase>::const_iterator it = cases.find(permutationKey());
+    if (it != cases.end()) {
+      alignLastLayer(it->second.auf, solution);
+      sequence(it->second.algorithm, solution);
+    }
+
+    // Final AUF, green edge goes to the front
+    if (edge[7].down == 'g')
+      alignLastLayer(1, solution);
+    else if (edge[6].down == 'g')
+      alignLastLayer(2, solution);
+    else if (edge[5].down == 'g')
+      alignLastLayer(3, solution);
+
+    if (!isSolved())
+      cout << "This Rubik's cube has no solution, you need swap two pieces of the bottom face.\n";
+  }
+  void Rubik::alignLastLayer(const int& turns, vector<char>& solution) {
+    if (turns == 1)
+      D(solution);
+    else if (turns == 2)
+      D2(solution);
+    else if (turns == 3)
+      d(solution);
+  }
+  int Rubik::orientationKey() const {
+    int key = 0;
+    for (int i = 4; i < 8; ++i)
+      key = key * 2 + ((edge[i].up == 'y') ? 0 : 1);
+    for (int i = 4; i < 8; ++i)
+      key = key * 3 + ((corner[i].up == 'y') ? 0 : ((corner[i].left == 'y') ? 1 : 2));
+
+    return key;
+  }
+  int Rubik::permutationKey() const {
+    int key = 0;
+    for (int i = 4; i < 8; ++i)
+      key = key * 8 + equivalentNumber(edge[i].down);
+    for (int i = 4; i < 8; ++i)
+      key = key * 8 + equivalentNumber(corner[i].left);
+
+    return key;
+  }
 
+  // Last layer algorithms, yellow face down. One per case: 57 OLL, 21 PLL.
+  static const char* const OLL_ALGORITHMS[57] = {
+    "LDDLLFLfDDlFLf",
+    "FLDldfBDRdrb",
+    "BDRdrbdFLDldf",
+    "BDRdrbDFLDldf",
+    "rBBLBlBR",
+    "RFFlfLfr",
+    "RFlFLFFr",
+    "rbLblBBR",
+    "LDldlFLLDldf",
+    "LDlDlFLfLDDl",
+    "RFlFlULuLFFr",
+    "lRlfLflFFLfLr",
+    "FDLdLLfLDLdl",
+    "lFLDlfLFdf",
+    "rbRldLDrBR",
+    "RFrLDldRfr",
+    "LDlDlFLfDDlFLf",
+    "RFlFLFFRRbLblBBR",
+    "rLBLBlblRlFLf",
+    "RFlfLLRRBLblblR",
+    "LDDldLDldLdl",
+    "LDDLLdLLdLLDDL",
+    "LLuLDDlULDDL",
+    "RFlfrFLf",
+    "fRFlfrFL",
+    "LDDldLdl",
+    "LDlDLDDl",
+    "RFlfLrDLdl",
+    "LDldLdlfdFLDl",
+    "FlFLLdldLDlFF",
+    "ldFDLdlfL",
+    "RDfdrDRFr",
+    "LDldlFLf",
+    "LDLLdlFLDLdf",
+    "LDDLLFLfLDDl",
+    "rdRdrDRDRfrF",
+    "FlfLDLdl",
+    "LDlDLdldlFLf",
+    "RfrdRDFdr",
+    "lFLDldfDL",
+    "LDlDLDDlFLDldf",
+    "ldLdlDDLFLDldf",
+    "fdrDRF",
+    "FDLdlf",
+    "FLDldf",
+    "ldlFLfDL",
+    "ldlFLflFLfDL",
+    "FLDldLDldf",
+    "RfRRBRRFRRbR",
+    "rBRRfRRbRRFr",
+    "FDLdlDLdlf",
+    "LDlDLdBdbl",
+    "lFFRFrfRFrFL",
+    "RFFlfLFlfLfr",
+    "lFLDLdLLfLLdlDLDl",
+    "rbRdlDLdlDLrBR",
+    "LDldlRFLfr"
+  };
+  static const char* const PLL_ALGORITHMS[21] = {
+    "lFlBBLflBBLL", // Aa
+    "LLBBLFlBBLfL", // Ab
+    "LblFLBlfLBlFLblf", // E
+    "ldfLDldlFLLdldLDlDL", // F
+    "LLDlDldLdLLdUlDLu", // Ga
+    "ldLDuLLDlDLdLdLLU", // Gb
+    "LLdLdLDlDLLDuLdlU", // Gc
+    "LDldULLdLdlDlDLLu", // Gd
+    "LLRRULLRRDDLLRRULLRR", // H
+    "lDrDDLdlDDLR", // Ja
+    "LDlfLDldlFLLdl", // Jb
+    "LDlDLDlfLDldlFLLdlDDLdl", // Na
+    "lDLdlfdFLDlFlfLdL", // Nb
+    "LdldLDLUldLulDDl", // Ra
+    "LLFLDLdlfLDDlDDL", // Rb
+    "LDldlFLLdldLDlf", // T
+    "LdLDLDLdldLL", // Ua
+    "LLDLDldldlDl", // Ub
+    "lDldblBBdbDbLBL", // V
+    "FLdldLDlfLDldlFLf", // Y
+    "lRFLLRRBLLRRFlRUULLRR"  // Z
+  };
+
+  static string inverseSequence(const string& sec) {
+    string inverse(sec.rbegin(), sec.rend());
+    for (unsigned int i = 0; i < inverse.size(); ++i)
+      inverse[i] = isupper(inverse[i]) ? tolower(inverse[i]) : toupper(inverse[i]);
+
+    return inverse;
+  }
 
-    // Orientate final edgess:
-    repeat = true;
-    int contador = 0;
-    while (repeat) {
-      if ((edge[4].down == 'r') && (edge[5].down == 'g') &&
-        (edge[6].down == 'l') && (edge[7].down == 'o')) { // bdBdbD2Bd ''
-        sequence("bdBdbDDBd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'o') && (edge[5].down == 'r') &&
-        (edge[6].down == 'l') && (edge[7].down == 'g')) { 	// rdRdrD2Rd '' reverse
-        sequence("rdRdrDDRd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'g') && (edge[5].down == 'r') &&
-        (edge[6].down == 'o') && (edge[7].down == 'l')) { // fdFdfD2Fd 'L'
-        sequence("fdFdfDDFd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'g') && (edge[5].down == 'l') &&
-        (edge[6].down == 'r') && (edge[7].down == 'o')) { 	// ldLdlD2Ld '_|'
-        sequence("ldLdlDDLd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'l') && (edge[5].down == 'r') &&
-        (edge[6].down == 'g') && (edge[7].down == 'o')) { 	// rdRdrD2RD2 && bdBdbD2Bd '--'
-        sequence("rdRdrDDRDDbdBdbDDBd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'g') && (edge[5].down == 'o') &&
-        (edge[6].down == 'l') && (edge[7].down == 'r')) { 	// rdRdrD2R && fdFdfD2Fd '|'
-        sequence("rdRdrDDRfdFdfDDFd", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'y') && (edge[5].down == 'y') &&
-        (edge[6].down == 'y') && (edge[7].down == 'y')) { 	//
-        sequence("RldRldRldRldRldRldRldRld", solution);
-        repeat = false;
-      }
-      else if ((edge[4].down == 'g') && (edge[5].down == 'r') &&
-        (edge[6].down == 'l') && (edge[7].down == 'o')) 	//
-        repeat = false;
-      else {
-        D(solution);
-        ++contador;
-        if (contador == 5) { // bdBdbD2Bd
-          contador = 0;
-          sequence("bdBdbDDBd", solution);
-          return;
+  const unordered_map<int, LastLayerCase>& Rubik::orientationCases() {
+    static const unordered_map<int, LastLayerCase> cases = [] {
+      unordered_map<int, LastLayerCase> table;
+      vector<char> scratch;
+      for (const char* algorithm : OLL_ALGORITHMS) {
+        // The case solved by the algorithm, seen from every AUF
+        Rubik aux;
+        aux.sequence(inverseSequence(algorithm).c_str(), scratch);
+        for (int auf = 0; auf < 4; ++auf) {
+          table.emplace(aux.orientationKey(), LastLayerCase{ algorithm, auf });
+          aux.d(scratch);
         }
       }
-    } // endwhile
-  }
-  void Rubik::finalCorners(vector<char>& solution) {
-    permutationFinalCorners(solution);
-    positionFinalCorners(solution);
-  }
-  void Rubik::permutationFinalCorners(vector<char>& solution) {
-    bool repeat = true;
-    while (repeat) {
-      if (searchCorner('y', 'o', 'g') == 4) {
-        if (searchCorner('y', 'r', 'l') == 5) // rDLdRDld
-          sequence("rDLdRDld", solution);
-        else if (searchCorner('y', 'r', 'l') == 7) // BdfDbdFD
-          sequence("BdfDbdFD", solution);
-
-        repeat = false;
+      return table;
+    }();
+    return cases;
+  }
+  const unordered_map<int, LastLayerCase>& Rubik::permutationCases() {
+    static const unordered_map<int, LastLayerCase> cases = [] {
+      unordered_map<int, LastLayerCase> table;
+      vector<char> scratch;
+      for (const char* algorithm : PLL_ALGORITHMS) {
+        // Final AUF is done by permuteLastLayer(), every ending is valid
+        for (int ending = 0; ending < 4; ++ending) {
+          Rubik aux;
+          for (int i = 0; i < ending; ++i)
+            aux.D(scratch);
+          aux.sequence(inverseSequence(algorithm).c_str(), scratch);
+          for (int auf = 0; auf < 4; ++auf) {
+            table.emplace(aux.permutationKey(), LastLayerCase{ algorithm, auf });
+            aux.d(scratch);
+          }
+        }
       }
-      else if (searchCorner('y', 'g', 'r') == 5) {
-        if (searchCorner('y', 'r', 'l') == 4) // bDFdBDfd
-          sequence("bDFdBDfd", solution);
-        else if (searchCorner('y', 'r', 'l') == 7) // LdrDldRD
-          sequence("LdrDldRD", solution);
+      return table;
+    }();
+    return cases;
+  }
 
-        repeat = false;
-      }
-      else if (searchCorner('y', 'l', 'o') == 7) {
-        if (searchCorner('y', 'r', 'l') == 4) // RdlDrdLD
-          sequence("RdlDrdLD", solution);
-        else if (searchCorner('y', 'r', 'l') == 5) // fDBdFDbd
-          sequence("fDBdFDbd", solution);
+  char& Rubik::sticker(const int& index) {
+    if (index < 24)
+      return (index % 2 == 0) ? edge[index / 2].up : edge[index / 2].down;
+    Corner& c = corner[(index - 24) / 3];
+    return ((index - 24) % 3 == 0) ? c.up : ((index - 24) % 3 == 1) ? c.left : c.right;
+  }
+  char Rubik::sticker(const int& index) const {
+    return const_cast<Rubik*>(this)->sticker(index);
+  }
 
-        repeat = false;
+  // Centers of each face of a movement, same order as center[]
+  static const char FACE_MOVES[] = "UFRBLD";
+
+  const vector<Symmetry>& Rubik::symmetries() {
+    static const vector<Symmetry> table = [] {
+      const Rubik solved;
+      // Face of each sticker and faces of its piece, as a bit set
+      int face[48], piece[48];
+      for (int k = 0; k < 48; ++k)
+        for (int f = 0; f < 6; ++f)
+          if (solved.sticker(k) == solved.center[f].center)
+            face[k] = f;
+      for (int k = 0; k < 48; ++k) {
+        int first = (k < 24) ? k - k % 2 : k - (k - 24) % 3, size = (k < 24) ? 2 : 3;
+        piece[k] = 0;
+        for (int i = first; i < first + size; ++i)
+          piece[k] |= 1 << face[i];
       }
-      else if (searchCorner('y', 'r', 'l') == 6) {
-        if (searchCorner('y', 'o', 'g') == 5) // FdbDfdBD
-          sequence("FdbDfdBD", solution);
-        else if (searchCorner('y', 'o', 'g') == 7) // lDRdLDrd
-          sequence("lDRdLDrd", solution);
 
-        repeat = false;
-      }
-      else // LdrDldRD
-        sequence("LdrDldRD", solution);
-    }
-  }
-  void Rubik::positionFinalCorners(vector<char>& solution) {
-    // Orientate final corners
-
-    if ((corner[4].up == 'y') && (corner[5].right == 'y') &&
-      (corner[7].up == 'y') && (corner[6].left == 'y')) // RD2rdRdrlD2LDlDL
-      sequence("RDDrdRdrlDDLDlDL", solution);
-    else if ((corner[4].left == 'y') && (corner[5].up == 'y') &&
-      (corner[7].right == 'y') && (corner[6].up == 'y')) // LD2ldLdlrD2RDrDR
-      sequence("LDDldLdlrDDRDrDR", solution);
-    else if ((corner[4].left == 'y') && (corner[5].right == 'y') &&
-      (corner[7].right == 'y') && (corner[6].left == 'y')) // RD2rdRdrlD2LDlDL LD2ldLdlrD2RDrDR
-      sequence("RDDrdRdrlDDLDlDLLDDldLdlrDDRDrDR", solution);
-    else if ((corner[4].right == 'y') && (corner[5].left == 'y') &&
-      (corner[7].up == 'y') && (corner[6].up == 'y')) // FD2fdFdfbD2BDbDB
-      sequence("FDDfdFdfbDDBDbDB", solution);
-    else if ((corner[4].up == 'y') && (corner[5].up == 'y') &&
-      (corner[7].left == 'y') && (corner[6].right == 'y')) // BD2bdBdbfD2FDfDF
-      sequence("BDDbdBdbfDDFDfDF", solution);
-    else if ((corner[4].right == 'y') && (corner[5].left == 'y') && //
-      (corner[7].left == 'y') && (corner[6].right == 'y')) // FD2fdFdfbD2BDbDB BD2bdBdbfD2FDfDF
-      sequence("FDDfdFdfbDDBDbDBBDDbdBdbfDDFDfDF", solution);
-    else if ((corner[4].up == 'y') && (corner[5].left == 'y') &&
-      (corner[7].up == 'y') && (corner[6].right == 'y')) // ldLdlD2LRDrDRD2r
-      sequence("ldLdlDDLRDrDRDDr", solution);
-    else if ((corner[4].right == 'y') && (corner[5].up == 'y') &&
-      (corner[7].left == 'y') && (corner[6].up == 'y')) // rdRdrD2RLDlDLD2l
-      sequence("rdRdrDDRLDlDLDDl", solution);
-    else if ((corner[4].up == 'y') && (corner[5].up == 'y') &&
-      (corner[7].right == 'y') && (corner[6].left == 'y')) // fdFdfD2FBDbDBD2b
-      sequence("fdFdfDDFBDbDBDDb", solution);
-    else if ((corner[4].left == 'y') && (corner[5].right == 'y') &&
-      (corner[7].up == 'y') && (corner[6].up == 'y')) // bdBdbD2BFDfDFD2f
-      sequence("bdBdbDDBFDfDFDDf", solution);
-    else if ((corner[4].left == 'y') && (corner[5].right == 'y') &&
-      (corner[7].right == 'y') && (corner[6].left == 'y')) // fdFdfD2FBDbDBD2b bdBdbD2BFDfDFD2f
-      sequence("fdFdfDDFBDbDBDDbbdBdbDDBFDfDFDDf", solution);
-    else if ((corner[4].right == 'y') && (corner[5].left == 'y') &&
-      (corner[7].right == 'y') && (corner[6].left == 'y')) // FD2fdFdfbD2BDbDB fdFdfD2FBDbDBD2b
-      sequence("FDDfdFdfbDDBDbDBfdFdfDDFBDbDBDDb", solution);
-    else if ((corner[4].left == 'y') && (corner[5].right == 'y') &&
-      (corner[7].left == 'y') && (corner[6].right == 'y')) // bdBdbD2BFDfDFD2f BD2bdBdbfD2FDfDF
-      sequence("bdBdbDDBFDfDFDDfBDDbdBdbfDDFDfDF", solution);
-    else if ((corner[4].right == 'y') && (corner[5].right == 'y') &&
-      (corner[7].left == 'y') && (corner[6].left == 'y')) // rdRdrD2RLDlDLD2l RD2rdRdrlD2LDlDL
-      sequence("rdRdrDDRLDlDLDDlRDDrdRdrlDDLDlDL", solution);
-    else if ((corner[4].left == 'y') && (corner[5].left == 'y') &&
-      (corner[7].right == 'y') && (corner[6].right == 'y')) // LD2ldLdlrD2RDrDR ldLdlD2LRDrDRD2r
-      sequence("LDDldLdlrDDRDrDRldLdlDDLRDrDRDDr", solution);
-
-    //
-    int yellows = 0;
-    for (int i = 0; i < 4; i++) {
-      if (corner[4 + i].up == 'y')
-        ++yellows;
-    }
-    if (yellows == 1) {
-      if (corner[4].up == 'y') {
-        if (corner[5].right == 'y') // RUruRUrudRUruRUrudRUruRUruD2
-          sequence("RUruRUrudRUruRUrudRUruRUruDD", solution);
-        else if (corner[5].left == 'y') // fuFUfuFUdfuFUfuFUdfuFUfuFUD2
-          sequence("fuFUfuFUdfuFUfuFUdfuFUfuFUDD", solution);//MISTAKE-RUSOSI
-      }
-      else if (corner[5].up == 'y') {
-        if (corner[4].right == 'y') // FUfuFUfuDFUfuFUfuDFUfuFUfuD2
-          sequence("FUfuFUfuDFUfuFUfuDFUfuFUfuDD", solution);
-        else if (corner[4].left == 'y') // luLUluLUDluLUluLUDluLUluLUD2
-          sequence("luLUluLUDluLUluLUDluLUluLUDD", solution);
-      }
-      else if (corner[6].up == 'y') {
-        if (corner[5].right == 'y') // RUruRUruDRUruRUruDRUruRUruD2
-          sequence("RUruRUruDRUruRUruDRUruRUruDD", solution);
-        else if (corner[5].left == 'y') // fuFUfuFUDfuFUfuF UDfuFUfuFUD2
-          sequence("fuFUfuFUDfuFUfuFUDfuFUfuFUDD", solution);
-      }
-      else if (corner[7].up == 'y') {
-        if (corner[5].right == 'y') // RUruRUruDRUruRUruD2RUruRUruD
-          sequence("RUruRUruDRUruRUruDDRUruRUruD", solution);
-        else if (corner[5].left == 'y') // fuFUfuFUDfuFUfuFUD2fuFUfuFUD
-          sequence("fuFUfuFUDfuFUfuFUDDfuFUfuFUD", solution);
-      }
-    }
-    else if (yellows == 2) {
-      if ((corner[4].up != 'y') && (corner[6].up != 'y')) {
-        if (corner[4].left == 'y') // luLUluLUD2luLUluLUluLUluLUD2
-          sequence("luLUluLUDDluLUluLUluLUluLUDD", solution);
-        else if (corner[4].right == 'y') // luLUluLUluLUluLUD2luLUluLUD2
-          sequence("luLUluLUluLUluLUDDluLUluLUDD", solution);
-      }
-      else if ((corner[5].up != 'y') && (corner[7].up != 'y')) {
-        if (corner[5].left == 'y') // fuFUfuFUD2fuFUfuFUfuFUfuFUD2
-          sequence("fuFUfuFUDDfuFUfuFUfuFUfuFUDD", solution);
-        else if (corner[5].right == 'y') // fuFUfuFUfuFUfuFUD2fuFUfuFUD2
-          sequence("fuFUfuFUfuFUfuFUDDfuFUfuFUDD", solution);
-      }
-    }
+      // Closure of two quarter rotations: around top face and around right face
+      const int aroundTop[6] = { 0, 2, 3, 4, 1, 5 }, aroundRight[6] = { 1, 5, 2, 0, 4, 3 };
+      vector<Symmetry> rotations(1);
+      for (int f = 0; f < 6; ++f)
+        rotations[0].face[f] = f;
+      for (unsigned int i = 0; i < rotations.size(); ++i)
+        for (const int* generator : { aroundTop, aroundRight }) {
+          Symmetry next;
+          for (int f = 0; f < 6; ++f)
+            next.face[f] = generator[rotations[i].face[f]];
+          bool known = false;
+          for (unsigned int j = 0; j < rotations.size() && !known; ++j)
+            known = equal(next.face, next.face + 6, rotations[j].face);
+          if (!known)
+            rotations.push_back(next);
+        }
+
+      for (Symmetry& s : rotations)
+        for (int k = 0; k < 48; ++k) {
+          int image = 0;
+          for (int f = 0; f < 6; ++f)
+            if (piece[k] & (1 << f))
+              image |= 1 << s.face[f];
+          for (int j = 0; j < 48; ++j)
+            if (face[j] == s.face[face[k]] && piece[j] == image)
+              s.sticker[k] = j;
+        }
+      return rotations;
+    }();
+    return table;
   }
 
   // Public interface
@@ -1129,36 +1203,47 @@ namespace rubik {
   }
 
   void Rubik::movSolver(vector<char>& moves) {
-    vector<char> cad;
+    vector<char>& cad = arena().turns;
 
+    for (char mov : moves) {
+      cad.clear();
+      turn(mov, cad);
+    }
+  }
+  void Rubik::movSolver(const MoveSequence& moves) {
+    vector<char>& cad = arena().turns;
 
     for (char mov : moves) {
-      if (mov == 'R')
-        R(cad);
-      else if (mov == 'r')
-        r(cad);
-      else if (mov == 'L')
-        L(cad);
-      else if (mov == 'l')
-        l(cad);
-      else if (mov == 'F')
-        F(cad);
-      else if (mov == 'f')
-        f(cad);
-      else if (mov == 'B')
-        B(cad);
-      else if (mov == 'b')
-        b(cad);
-      else if (mov == 'U')
-        U(cad);
-      else if (mov == 'u')
-        u(cad);
-      else if (mov == 'D')
-        D(cad);
-      else if (mov == 'd')
-        d(cad);
+      cad.clear();
+      turn(mov, cad);
     }
   }
+  void Rubik::turn(const char& mov, vector<char>& solution) {
+    if (mov == 'R')
+      R(solution);
+    else if (mov == 'r')
+      r(solution);
+    else if (mov == 'L')
+      L(solution);
+    else if (mov == 'l')
+      l(solution);
+    else if (mov == 'F')
+      F(solution);
+    else if (mov == 'f')
+      f(solution);
+    else if (mov == 'B')
+      B(solution);
+    else if (mov == 'b')
+      b(solution);
+    else if (mov == 'U')
+      U(solution);
+    else if (mov == 'u')
+      u(solution);
+    else if (mov == 'D')
+      D(solution);
+    else if (mov == 'd')
+      d(solution);
+  }
 
 
   bool Rubik::isSolved() const {
@@ -1827,22 +1912,14 @@ namespace rubik {
     cout << "Press any key: ";
     cin.ignore(1024, '\n');
 
-    yellowCross(solution);
+    orientLastLayer(solution);
     explainMovements(solution, mov);
     printAll();
-    cout << "### The yellow cross it's made. ";
+    cout << "### The yellow face it's made. ";
     cout << "Press any key: ";
     cin.ignore(1024, '\n');
 
-
-    permutationFinalCorners(solution);
-    explainMovements(solution, mov);
-    printAll();
-    cout << "### The final corners are good located, but probably not oriented. ";
-    cout << "Press any key: ";
-    cin.ignore(1024, '\n');
-
-    positionFinalCorners(solution);
+    permuteLastLayer(solution);
     explainMovements(solution, mov);
     printAll();
     printf(BT_ON "\n\n\t--->  Good job :D !! <---\n" RESET);
@@ -1854,6 +1931,289 @@ namespace rubik {
       secondStep(solution); // Middle step
       thirdStep(solution); // Bottom face
     }
+    else if (method == 'S') { // Beginners method after short prefixes
+      const atomic<bool> never(false);
+      Rubik aux(*this);
+      aux.solve(solution);
+      simplify(solution);
+      improveSolution(solution, SEARCH_DEPTH, never);
+      movSolver(solution);
+    }
+  }
+  void Rubik::solve(const PhaseCallback& emit, const char& method) {
+    vector<char> moves;
+    if (method == 'B') {
+      whiteCross(moves);
+      emit("whiteCross", moves);
+      moves.clear();
+      cornersFirstStep(moves);
+      emit("cornersFirstStep", moves);
+      moves.clear();
+      secondStep(moves);
+      emit("secondStep", moves);
+      moves.clear();
+      orientLastLayer(moves);
+      emit("orientLastLayer", moves);
+      moves.clear();
+      permuteLastLayer(moves);
+      emit("permuteLastLayer", moves);
+    }
+    else {
+      solve(moves, method);
+      emit("solution", moves);
+    }
+  }
+  SolveStatus Rubik::solve(vector<char>& solution, const chrono::steady_clock::time_point& deadline,
+                           const atomic<bool>& cancel, const char& method) {
+    SearchBudget budget = { deadline, &cancel };
+    bool finished = true;
+    SearchArena& memory = arena();
+    memory.nodes[0] = *this;
+    memory.prefix.clear();
+    solve(solution); // Bounded, there is always a solution to return
+    if (method == 'S') {
+      simplify(solution);
+      for (int depth = 1; depth <= SEARCH_MAX_DEPTH && finished; ++depth) {
+        searchPrefix(memory, depth, solution, budget);
+        finished = !budget.exhausted();
+      }
+    }
+
+    SolveStatus status = Optimal;
+    if (!finished) // Stopped early: by the token, or else by the deadline
+      status = cancel ? Cancelled : BudgetLimited;
+
+    return status;
+  }
+  bool Rubik::improveSolution(vector<char>& solution, const int& depth, const atomic<bool>& stop) const {
+    SearchBudget budget = { chrono::steady_clock::time_point::max(), &stop };
+    bool improved = false;
+    SearchArena& memory = arena();
+    memory.nodes[0] = *this;
+    memory.prefix.clear();
+    for (int d = 0; d <= min(depth, SEARCH_MAX_DEPTH) && !budget.exhausted(); ++d) {
+      if (searchPrefix(memory, d, solution, budget))
+        improved = true;
+    }
+    return improved;
+  }
+  bool SearchBudget::exhausted() const {
+    return *cancel || chrono::steady_clock::now() >= deadline;
+  }
+  void Rubik::solveColourNeutral(vector<char>& solution, const char& method, const unsigned int& threads) {
+    vector<vector<char> > candidates(SYMMETRIES);
+    atomic<int> next(0);
+    auto worker = [&] {
+      for (int i = next++; i < SYMMETRIES; i = next++) {
+        Rubik aux = symmetric(i);
+        aux.solve(candidates[i], method);
+        simplify(candidates[i]);
+        symmetricMoves(candidates[i], inverseSymmetry(i)); // Back to our colours
+      }
+    };
+
+    unsigned int workers = (threads > 0) ? threads : thread::hardware_concurrency();
+    workers = max(1u, min(workers, (unsigned int)SYMMETRIES));
+    vector<thread> pool;
+    for (unsigned int i = 1; i < workers; ++i)
+      pool.emplace_back(worker);
+    worker();
+    for (thread& t : pool)
+      t.join();
+
+    int best = 0;
+    for (int i = 1; i < SYMMETRIES; ++i)
+      if (candidates[i].size() < candidates[best].size())
+        best = i;
+    solution = candidates[best];
+    movSolver(solution);
+  }
+  bool Rubik::searchPrefix(SearchArena& arena, const int& depth, vector<char>& best, const SearchBudget& budget) {
+    vector<char>& prefix = arena.prefix;
+    const unsigned int level = prefix.size();
+    bool improved = false;
+    if (level >= best.size()) // The prefix alone is not shorter
+      return improved;
+    if (depth == 0) {
+      vector<char>& candidate = arena.candidate;
+      const size_t capacity = arena.solution.capacity();
+      Rubik aux(arena.nodes[level]);
+      aux.solve(arena.solution);
+      if (arena.solution.capacity() != capacity)
+        ++arena.allocations;
+      arena.reserve(candidate, level + arena.solution.size());
+      candidate.assign(prefix.begin(), prefix.end());
+      candidate.insert(candidate.end(), arena.solution.begin(), arena.solution.end());
+      simplify(candidate);
+      if (candidate.size() < best.size()) {
+        best.assign(candidate.begin(), candidate.end()); // Shorter, fits in best
+        improved = true;
+      }
+    }
+    else {
+      static const char moves[] = "RrLlFfBbUuDd";
+      for (unsigned int i = 0; i < 12 && !budget.exhausted(); ++i) {
+        // Skip Xx and XXX, they are shorter prefixes
+        if (level > 0 && tolower(prefix.back()) == tolower(moves[i]) &&
+          (prefix.back() != moves[i] || (level > 1 && prefix[level - 2] == moves[i])))
+          continue;
+        arena.nodes[level + 1] = arena.nodes[level];
+        arena.turns.clear();
+        arena.nodes[level + 1].turn(moves[i], arena.turns);
+        prefix.push_back(moves[i]);
+        if (searchPrefix(arena, depth - 1, best, budget))
+          improved = true;
+        prefix.pop_back();
+      }
+    }
+    return improved;
+  }
+  void Rubik::simplify(vector<char>& moves) {
+    // In place, the simplified prefix is never longer than the movements read
+    unsigned int n = 0;
+    for (char mov : moves) {
+      if (n > 0 && moves[n - 1] != mov && tolower(moves[n - 1]) == tolower(mov)) // Xx
+        --n;
+      else if (n > 1 && moves[n - 1] == mov && moves[n - 2] == mov) { // XXX --> x
+        n -= 2;
+        moves[n++] = isupper(mov) ? tolower(mov) : toupper(mov);
+      }
+      else
+        moves[n++] = mov;
+    }
+    moves.resize(n);
+  }
+  SearchArena& Rubik::arena() {
+    static thread_local SearchArena memory;
+    return memory;
+  }
+  unsigned long Rubik::arenaAllocations() {
+    return arena().allocations;
+  }
+  SearchArena::SearchArena() : allocations(0) {
+    reserve(prefix, SEARCH_MAX_DEPTH);
+    reserve(candidate, ARENA_MOVES);
+    reserve(solution, ARENA_MOVES);
+    reserve(turns, ARENA_MOVES);
+  }
+  void SearchArena::reserve(vector<char>& buffer, const size_t& size) {
+    if (size > buffer.capacity()) {
+      buffer.reserve(max(size, 2 * buffer.capacity()));
+      ++allocations;
+    }
+  }
+  const PhaseCounters& Rubik::counters(const Phase& phase) {
+    return phaseCounters[phase];
+  }
+  void Rubik::resetCounters() {
+    for (PhaseCounters& c : phaseCounters)
+      c = PhaseCounters();
+  }
+  void Rubik::exportCounters(std::ostream& os) {
+    static const char* const names[PHASES] = { "whiteCross", "cornersFirstStep", "secondStep",
+                                               "orientLastLayer", "permuteLastLayer" };
+#ifdef RUBIK_INSTRUMENTATION
+    os << "{\n  \"enabled\": true,\n  \"phases\": [";
+#else
+    os << "{\n  \"enabled\": false,\n  \"phases\": [";
+#endif
+    for (int i = 0; i < PHASES; ++i) {
+      const PhaseCounters& c = phaseCounters[i];
+      os << (i > 0 ? "," : "") << "\n    { \"name\": \"" << names[i] << "\", \"runs\": " << c.runs
+         << ", \"seconds\": " << c.seconds << ", \"moves\": " << c.moves
+         << ", \"searchEdgeCalls\": " << c.searchEdgeCalls << ", \"searchCornerCalls\": " << c.searchCornerCalls
+         << ", \"sequences\": " << c.sequences << ", \"iterations\": " << c.iterations << " }";
+    }
+    os << "\n  ]\n}" << endl;
+  }
+  bool Rubik::relabel(const Rubik& target, Rubik& result) const {
+    const Rubik solved;
+    result = *this;
+    for (int i = 0; i < 6; ++i)
+      if (center[i].center != target.center[i].center)
+        return false;
+
+    int found = 0;
+    for (int p = 0; p < 12; ++p) // Edge of target in position p
+      for (int q = 0; q < 12; ++q) {
+        const Edge& e = edge[q], & t = target.edge[p];
+        if (e.up == t.up && e.down == t.down)
+          result.edge[q] = solved.edge[p];
+        else if (e.up == t.down && e.down == t.up) // Flipped
+          result.edge[q] = { solved.edge[p].down, solved.edge[p].up };
+        else
+          continue;
+        ++found;
+      }
+
+    for (int p = 0; p < 8; ++p) // Corner of target in position p
+      for (int q = 0; q < 8; ++q) {
+        const char c[3] = { corner[q].up, corner[q].left, corner[q].right };
+        const char t[3] = { target.corner[p].up, target.corner[p].left, target.corner[p].right };
+        const char s[3] = { solved.corner[p].up, solved.corner[p].left, solved.corner[p].right };
+        char r[3];
+        int matched = 0;
+        for (int i = 0; i < 3; ++i) // Colour t[j] is renamed as s[j]
+          for (int j = 0; j < 3; ++j)
+            if (c[i] == t[j]) {
+              r[i] = s[j];
+              ++matched;
+            }
+        if (matched == 3) {
+          result.corner[q] = { r[0], r[1], r[2] };
+          ++found;
+        }
+      }
+
+    return found == 20;
+  }
+  Rubik Rubik::symmetric(const int& symmetry) const {
+    const Symmetry& s = symmetries()[symmetry];
+    char colour[256];
+    for (int f = 0; f < 6; ++f)
+      colour[(unsigned char)center[f].center] = center[s.face[f]].center;
+
+    Rubik result(*this);
+    for (int k = 0; k < 48; ++k)
+      result.sticker(s.sticker[k]) = colour[(unsigned char)sticker(k)];
+    return result;
+  }
+  string Rubik::canonicalKey(int& symmetry) const {
+    string key;
+    for (int i = 0; i < SYMMETRIES; ++i) {
+      Rubik aux = symmetric(i);
+      string candidate(48, ' ');
+      for (int k = 0; k < 48; ++k)
+        candidate[k] = aux.sticker(k);
+      if (i == 0 || candidate < key) {
+        key = candidate;
+        symmetry = i;
+      }
+    }
+    return key;
+  }
+  void Rubik::symmetricMoves(vector<char>& moves, const int& symmetry) {
+    const Symmetry& s = symmetries()[symmetry];
+    for (char& mov : moves) {
+      int f = strchr(FACE_MOVES, toupper(mov)) - FACE_MOVES;
+      mov = isupper(mov) ? FACE_MOVES[s.face[f]] : tolower(FACE_MOVES[s.face[f]]);
+    }
+  }
+  int Rubik::inverseSymmetry(const int& symmetry) {
+    const vector<Symmetry>& table = symmetries();
+    int inverse = 0;
+    for (int i = 0; i < SYMMETRIES; ++i)
+      if (table[symmetry].face[table[i].face[0]] == 0 && table[symmetry].face[table[i].face[1]] == 1)
+        inverse = i;
+    return inverse;
+  }
+  bool Rubik::solveBetween(const Rubik& from, const Rubik& to, vector<char>& solution, const char& method) {
+    Rubik aux;
+    solution.clear();
+    if (!from.relabel(to, aux) || aux.logicErrors() != 0)
+      return false;
+    aux.solve(solution, method);
+    return true;
   }
 
   void Rubik::fileExample() {
@@ -2083,6 +2443,34 @@ namespace rubik {
         cout << "Invalid char. Try again:\n";
     } while (c == 'f');
   }
+  bool Rubik::setFacelets(const char* facelets) {
+    char* stickers[54] = {
+      &corner[3].up, &edge[2].up, &corner[2].up, &edge[3].up, &center[0].center, &edge[1].up,
+      &corner[0].up, &edge[0].up, &corner[1].up,
+      &corner[3].right, &edge[3].down, &corner[0].left, &edge[10].down, &center[4].center, &edge[11].down,
+      &corner[7].right, &edge[7].down, &corner[4].left,
+      &corner[0].right, &edge[0].down, &corner[1].left, &edge[11].up, &center[1].center, &edge[8].up,
+      &corner[4].right, &edge[4].down, &corner[5].left,
+      &corner[1].right, &edge[1].down, &corner[2].left, &edge[8].down, &center[2].center, &edge[9].down,
+      &corner[5].right, &edge[5].down, &corner[6].left,
+      &corner[2].right, &edge[2].down, &corner[3].left, &edge[9].up, &center[3].center, &edge[10].up,
+      &corner[6].right, &edge[6].down, &corner[7].left,
+      &corner[4].up, &edge[4].up, &corner[5].up, &edge[7].up, &center[5].center, &edge[5].up,
+      &corner[7].up, &edge[6].up, &corner[6].up };
+    static const char colours[] = "wogrly";
+    char read[54];
+    for (int i = 0; i < 54; ++i) {
+      char c = tolower(facelets[i]);
+      if (c >= '1' && c <= '6')
+        c = colours[c - '1'];
+      if (c == '\0' || strchr(colours, c) == NULL)
+        return false;
+      read[i] = c;
+    }
+    for (int i = 0; i < 54; ++i)
+      *stickers[i] = read[i];
+    return true;
+  }
   void Rubik::readRubik(std::istream& is) {
     bool success = true;
     if (is.fail())
@@ -2255,6 +2643,242 @@ namespace rubik {
     return (!(*this == rubik));
   }
 
+  // Cube group
+  // Stickers of a corner, clockwise from the up/down one in both layers
+  static void cornerStickers(const Corner& c, const int& position, char s[3]) {
+    s[0] = c.up;
+    s[1] = (position < 4) ? c.left : c.right;
+    s[2] = (position < 4) ? c.right : c.left;
+  }
+  static unsigned long gcd(unsigned long a, unsigned long b) {
+    return (b == 0) ? a : gcd(b, a % b);
+  }
+
+  CubieState CubieState::identity() {
+    CubieState state;
+    for (int i = 0; i < 8; ++i) {
+      state.cornerPerm[i] = i;
+      state.cornerOri[i] = 0;
+    }
+    for (int i = 0; i < 12; ++i) {
+      state.edgePerm[i] = i;
+      state.edgeOri[i] = 0;
+    }
+    return state;
+  }
+  CubieState CubieState::fromMoves(const string& moves) {
+    static const string names = "RrLlFfBbUuDd";
+    static const vector<CubieState> generators = [] {
+      vector<CubieState> table;
+      for (char mov : names) {
+        Rubik aux;
+        vector<char> sequence(1, mov);
+        aux.movSolver(sequence);
+        table.push_back(fromRubik(aux));
+      }
+      return table;
+    }();
+
+    CubieState state = identity();
+    for (char mov : moves)
+      state = state.compose(generators[names.find(mov)]);
+    return state;
+  }
+  CubieState CubieState::fromRubik(const Rubik& rubik) {
+    static const Rubik solved;
+    CubieState state = identity();
+    fill(state.cornerPerm, state.cornerPerm + 8, 8); // Unknown pieces
+    fill(state.edgePerm, state.edgePerm + 12, 12);
+    for (int i = 0; i < 8; ++i) {
+      char s[3], t[3];
+      cornerStickers(rubik.getCorner(i), i, s);
+      for (int p = 0; p < 8; ++p) {
+        cornerStickers(solved.getCorner(p), p, t);
+        for (int o = 0; o < 3; ++o)
+          if (s[o] == t[0] && s[(o + 1) % 3] == t[1] && s[(o + 2) % 3] == t[2]) {
+            state.cornerPerm[i] = p;
+            state.cornerOri[i] = o;
+          }
+      }
+    }
+    for (int i = 0; i < 12; ++i) {
+      Edge e = rubik.getEdge(i);
+      for (int p = 0; p < 12; ++p) {
+        Edge t = solved.getEdge(p);
+        if (e.up == t.up && e.down == t.down)
+          state.edgePerm[i] = p;
+        else if (e.up == t.down && e.down == t.up) {
+          state.edgePerm[i] = p;
+          state.edgeOri[i] = 1;
+        }
+      }
+    }
+    return state;
+  }
+  CubieState CubieState::compose(const CubieState& other) const {
+    CubieState state;
+    for (int i = 0; i < 8; ++i) {
+      state.cornerPerm[i] = cornerPerm[other.cornerPerm[i]];
+      state.cornerOri[i] = (cornerOri[other.cornerPerm[i]] + other.cornerOri[i]) % 3;
+    }
+    for (int i = 0; i < 12; ++i) {
+      state.edgePerm[i] = edgePerm[other.edgePerm[i]];
+      state.edgeOri[i] = (edgeOri[other.edgePerm[i]] + other.edgeOri[i]) % 2;
+    }
+    return state;
+  }
+  CubieState CubieState::inverse() const {
+    CubieState state;
+    for (int i = 0; i < 8; ++i) {
+      state.cornerPerm[cornerPerm[i]] = i;
+      state.cornerOri[cornerPerm[i]] = (3 - cornerOri[i]) % 3;
+    }
+    for (int i = 0; i < 12; ++i) {
+      state.edgePerm[edgePerm[i]] = i;
+      state.edgeOri[edgePerm[i]] = edgeOri[i];
+    }
+    return state;
+  }
+  CubieState CubieState::power(long long n) const {
+    CubieState base = (n < 0) ? inverse() : *this, result = identity();
+    for (n = (n < 0) ? -n : n; n > 0; n /= 2) {
+      if (n % 2 == 1)
+        result = result.compose(base);
+      base = base.compose(base);
+    }
+    return result;
+  }
+  unsigned long CubieState::order() const {
+    vector<Cycle> corners, edges;
+    cycleStructure(corners, edges);
+    unsigned long result = 1;
+    for (const Cycle& c : corners) {
+      unsigned long length = c.length * ((c.orientation != 0) ? 3 : 1);
+      result = result / gcd(result, length) * length;
+    }
+    for (const Cycle& c : edges) {
+      unsigned long length = c.length * ((c.orientation != 0) ? 2 : 1);
+      result = result / gcd(result, length) * length;
+    }
+    return result;
+  }
+  void CubieState::cycleStructure(vector<Cycle>& corners, vector<Cycle>& edges) const {
+    bool visited[12] = { false };
+    corners.clear();
+    for (int i = 0; i < 8; ++i)
+      if (!visited[i]) {
+        Cycle c = { 0, 0 };
+        for (int j = i; !visited[j]; j = cornerPerm[j]) {
+          visited[j] = true;
+          ++c.length;
+          c.orientation = (c.orientation + cornerOri[j]) % 3;
+        }
+        if (c.length > 1 || c.orientation != 0)
+          corners.push_back(c);
+      }
+
+    fill(visited, visited + 12, false);
+    edges.clear();
+    for (int i = 0; i < 12; ++i)
+      if (!visited[i]) {
+        Cycle c = { 0, 0 };
+        for (int j = i; !visited[j]; j = edgePerm[j]) {
+          visited[j] = true;
+          ++c.length;
+          c.orientation = (c.orientation + edgeOri[j]) % 2;
+        }
+        if (c.length > 1 || c.orientation != 0)
+          edges.push_back(c);
+      }
+  }
+  bool CubieState::solvable() const {
+    bool seenCorner[8] = { false }, seenEdge[12] = { false };
+    int twist = 0, flip = 0, swaps = 0;
+    for (int i = 0; i < 8; ++i) {
+      if (cornerPerm[i] >= 8 || seenCorner[cornerPerm[i]])
+        return false;
+      seenCorner[cornerPerm[i]] = true;
+      twist += cornerOri[i];
+    }
+    for (int i = 0; i < 12; ++i) {
+      if (edgePerm[i] >= 12 || seenEdge[edgePerm[i]])
+        return false;
+      seenEdge[edgePerm[i]] = true;
+      flip += edgeOri[i];
+    }
+    // Parity of the permutations: number of inversions
+    for (int i = 0; i < 8; ++i)
+      for (int j = i + 1; j < 8; ++j)
+        swaps += cornerPerm[i] > cornerPerm[j];
+    for (int i = 0; i < 12; ++i)
+      for (int j = i + 1; j < 12; ++j)
+        swaps += edgePerm[i] > edgePerm[j];
+    return twist % 3 == 0 && flip % 2 == 0 && swaps % 2 == 0;
+  }
+  bool CubieState::operator==(const CubieState& other) const {
+    return equal(cornerPerm, cornerPerm + 8, other.cornerPerm) && equal(cornerOri, cornerOri + 8, other.cornerOri) &&
+           equal(edgePerm, edgePerm + 12, other.edgePerm) && equal(edgeOri, edgeOri + 12, other.edgeOri);
+  }
+  bool CubieState::operator!=(const CubieState& other) const {
+    return !(*this == other);
+  }
+
+  // Solution cache
+  SolutionCache::SolutionCache(const size_t& capacity) : capacity(capacity), hits(0), misses(0) {}
+
+  bool SolutionCache::solve(Rubik& rubik, vector<char>& solution, const char& method, const bool& colourNeutral) {
+    if (lookup(rubik, solution, method, colourNeutral)) {
+      rubik.movSolver(solution);
+      return true;
+    }
+
+    Rubik start(rubik);
+    if (colourNeutral)
+      rubik.solveColourNeutral(solution, method);
+    else
+      rubik.solve(solution, method);
+    insert(start, solution, method, colourNeutral);
+    return false;
+  }
+  bool SolutionCache::lookup(const Rubik& rubik, vector<char>& solution, const char& method, const bool& colourNeutral) {
+    int symmetry;
+    string key = string(1, method) + (colourNeutral ? 'N' : ' ') + rubik.canonicalKey(symmetry);
+    auto found = index.find(key);
+    if (found == index.end()) {
+      ++misses;
+      return false;
+    }
+
+    entries.splice(entries.begin(), entries, found->second); // Most recent
+    solution = found->second->second;
+    Rubik::symmetricMoves(solution, Rubik::inverseSymmetry(symmetry));
+    ++hits;
+    return true;
+  }
+  void SolutionCache::insert(const Rubik& rubik, const vector<char>& solution, const char& method, const bool& colourNeutral) {
+    int symmetry;
+    string key = string(1, method) + (colourNeutral ? 'N' : ' ') + rubik.canonicalKey(symmetry);
+    vector<char> stored(solution);
+    Rubik::symmetricMoves(stored, symmetry);
+    auto found = index.find(key);
+    if (found != index.end()) {
+      found->second->second = stored;
+      entries.splice(entries.begin(), entries, found->second);
+      return;
+    }
+
+    entries.emplace_front(key, stored);
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+  void SolutionCache::clear() {
+    entries.clear();
+    index.clear();
+  }
+
   // External methods
   std::ostream& operator<<(std::ostream& os, const Rubik& rubik) {
     rubik.exportRubik(os);
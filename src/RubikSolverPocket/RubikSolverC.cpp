@@ -0,0 +1,78 @@
+#include <string.h>
+#include <vector>
+#include "RubikSolverPocket/RubikSolver.h"
+#include "RubikSolverPocket/RubikSolverC.h"
+
+using namespace std;
+using namespace rubik;
+
+// Solution of the calling thread, reserved once
+static vector<char>& solutionBuffer() {
+  static thread_local vector<char> buffer(4 * RUBIK_MAX_MOVES);
+  return buffer;
+}
+
+static int readCube(const char* facelets, Rubik& rubik) {
+  static const Rubik solved;
+  if (facelets == NULL)
+    return RUBIK_ERROR_ARGUMENT;
+  if (!rubik.setFacelets(facelets))
+    return RUBIK_ERROR_COLOUR;
+  if (rubik.logicErrors() != 0)
+    return RUBIK_ERROR_COUNT;
+  for (int i = 0; i < 6; ++i)
+    if (rubik.getCenter(i).center != solved.getCenter(i).center)
+      return RUBIK_ERROR_CENTERS;
+  if (!CubieState::fromRubik(rubik).solvable())
+    return RUBIK_ERROR_UNSOLVABLE;
+  return RUBIK_OK;
+}
+
+int rubik_thread_init(void) {
+  Rubik rubik;
+  rubik.movSolver(MoveSequence("RUrFDlBd"));
+  rubik.solve(solutionBuffer(), 'S'); // Search arena and tables of the last layer
+  return RUBIK_OK;
+}
+
+int rubik_validate(const char* facelets) {
+  Rubik rubik;
+  return readCube(facelets, rubik);
+}
+
+int rubik_solve(const char* facelets, char method, char* moves, size_t capacity) {
+  Rubik rubik;
+  int error = readCube(facelets, rubik);
+  if (error != RUBIK_OK)
+    return error;
+  if (moves == NULL || (method != 'B' && method != 'S'))
+    return RUBIK_ERROR_ARGUMENT;
+
+  vector<char>& solution = solutionBuffer();
+  rubik.solve(solution, method);
+  Rubik::simplify(solution);
+  if (solution.size() > capacity)
+    return RUBIK_ERROR_CAPACITY;
+  if (!solution.empty())
+    memcpy(moves, solution.data(), solution.size());
+  return int(solution.size());
+}
+
+const char* rubik_error_string(int error) {
+  switch (error) {
+  case RUBIK_ERROR_ARGUMENT:
+    return "null pointer or unknown method";
+  case RUBIK_ERROR_COLOUR:
+    return "a facelet is not a colour";
+  case RUBIK_ERROR_COUNT:
+    return "wrong number of stickers of a colour";
+  case RUBIK_ERROR_CENTERS:
+    return "centers are not in the orientation of the solved cube";
+  case RUBIK_ERROR_UNSOLVABLE:
+    return "the cube can not be solved";
+  case RUBIK_ERROR_CAPACITY:
+    return "the solution does not fit in the buffer";
+  default:
+    return (error >= 0) ? "ok" : "unknown error";
+  }
+}
@@ -1,8 +1,35 @@
 #include "RubikSolverPocket/RubikSolver.h"
 #include "App/Application.hpp"
+#include "App/Benchmark.hpp"
+#include "App/Verifier.hpp"
 #include <sstream>
 
-int main() {
+int main(int argc, char* argv[]) {
+  //Headless: RubikCubeVS --verify [cases] [method]
+  if (argc > 1 && std::string(argv[1]) == "--verify") {
+    app::SolverEngineVerifier verifier;
+    std::size_t cases = (argc > 2) ? std::stoul(argv[2]) : 1000000;
+    char method = (argc > 3) ? argv[3][0] : 'B';
+    return (verifier.run(cases, method) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  //Headless: RubikCubeVS --benchmark [solves] [method]
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    std::size_t solves = (argc > 2) ? std::stoul(argv[2]) : 10000;
+    char method = (argc > 3) ? argv[3][0] : 'B';
+    app::SolverBenchmark::run(solves, method);
+    return EXIT_SUCCESS;
+  }
+#ifdef RUBIK_HEADLESS
+  //Headless rendering, no display needed: RubikCubeVS --headless [actions] [max frames] [frame prefix] [profile csv]
+  if (argc > 1 && std::string(argv[1]) == "--headless") {
+    std::string actions = (argc > 2) ? argv[2] : "MS";
+    std::size_t frames = (argc > 3) ? std::stoul(argv[3]) : 100000;
+    std::string prefix = (argc > 4) ? argv[4] : "";
+    std::string profile = (argc > 5) ? argv[5] : "";
+    app::GL3D_HeadlessApplication api(SCREEN_SIZE_X, SCREEN_SIZE_Y);
+    return api.start(actions, frames, HEADLESS_FRAME_RATE, prefix, profile);
+  }
+#endif
   eng::initOpenGL();
   app::GL3D_WindowApplication api(SCREEN_SIZE_X, SCREEN_SIZE_Y, "RUSOSI");
   api.start();